@@ -8,12 +8,19 @@ print_usage(){
 	echo "If deploy them on a hub chain, you need to compile with the hub protocol."
     echo "$ ./build.sh bos.cdt HUB_PROTOCOL=ON"
 	echo "$ ./build.sh eosio.cdt HUB_PROTOCOL=ON"
+	echo ""
+	echo "Log level, 0: none, 1: info (default), 2: debug, debug builds print a trace of every header and must not be deployed."
+	echo "$ ./build.sh bos.cdt LOG_LEVEL=2"
+	echo "$ ./build.sh bos.cdt HUB_PROTOCOL=ON LOG_LEVEL=0"
+	echo ""
+	echo "Instrumented build, every action prints its db, crypto and inline action counters, only for test networks."
+	echo "$ ./build.sh bos.cdt INSTRUMENT=ON"
 }
 
 eosio_cdt_version=1.5
 bos_cdt_version=3.0.1
 
-if [ $# -gt 2 ];then
+if [ $# -gt 4 ];then
     echo "too much arguments" && exit 0
 fi
 
@@ -39,15 +46,23 @@ replace_in_file(){
 sed 's/set(EOSIO_CDT_VERSION_MIN.*/set(EOSIO_CDT_VERSION_MIN '${cdt_version}')/g' ./CMakeLists_gen.txt > CMakeLists.txt
 replace_in_file "set(EOSIO_CDT_VERSION_SOFT_MAX.*" 'set(EOSIO_CDT_VERSION_SOFT_MAX '${cdt_version}')'
 
-if [ $# -eq 2 ];then
-    if [ "$2" == "HUB_PROTOCOL=ON" ];then
-        replace_in_file "HUB_PROTOCOL_SWITCH" "add_definitions(-DHUB)"
+hub_protocol=""
+log_level=""
+instrument=""
+for arg in "${@:2}"; do
+    if [ "$arg" == "HUB_PROTOCOL=ON" ];then
+        hub_protocol="add_definitions(-DHUB)"
+    elif [[ "$arg" =~ ^LOG_LEVEL=[0-2]$ ]];then
+        log_level="add_definitions(-DIBC_LOG_LEVEL=${arg#LOG_LEVEL=})"
+    elif [ "$arg" == "INSTRUMENT=ON" ];then
+        instrument="add_definitions(-DIBC_INSTRUMENT)"
     else
-        echo "unknown parameter: " $2 && exit 0
+        echo "unknown parameter: " $arg && exit 0
     fi
-else
-    replace_in_file "HUB_PROTOCOL_SWITCH" ""
-fi
+done
+replace_in_file "HUB_PROTOCOL_SWITCH" "${hub_protocol}"
+replace_in_file "IBC_LOG_LEVEL_SWITCH" "${log_level}"
+replace_in_file "IBC_INSTRUMENT_SWITCH" "${instrument}"
 
 printf "\t=========== building ibc_contracts ===========\n\n"
 
@@ -41,6 +41,21 @@ namespace eosio {
 
       EOSLIB_SERIALIZE_DERIVED( signed_block_header, block_header, (producer_signature) )
    };
+
+   /**
+    * the leading fields of a packed std::vector<signed_block_header>, read from the raw bytes,
+    * used to reject a batch of headers before unpacking all of them
+    */
+   struct headers_prefix {
+      uint32_t          count = 0;
+      block_id_type     first_previous;
+
+      uint32_t first_block_num() const { return block_header::num_from_id(first_previous) + 1; }
+   };
+
+   headers_prefix read_headers_prefix( const std::vector<char>& headers_data );
+   signed_block_header read_first_header( const std::vector<char>& headers_data );
+   uint32_t read_vector_size( const std::vector<char>& data );
 /*
    struct key_weight {
       public_key        key;
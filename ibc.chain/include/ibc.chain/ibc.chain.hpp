@@ -5,16 +5,20 @@
 #pragma once
 
 #include <eosiolib/core/eosio/asset.hpp>
+#include <eosiolib/core/eosio/binary_extension.hpp>
 #include <eosiolib/contracts/eosio/eosio.hpp>
 #include <eosiolib/contracts/eosio/singleton.hpp>
 #include <ibc.chain/block_header.hpp>
 #include <ibc.chain/pbft.hpp>
 #include <ibc.chain/merkle.hpp>
+#include <ibc.chain/log.hpp>
 
 namespace eosio {
 
    const static uint32_t section_max_length = 1000;   // used under pipeline consensus algorithm
    const static uint32_t lib_depth = 325;             // don't modify, used under pipeline consensus algorithm
+   const static uint32_t max_section_work = 150;      // blocks removed plus headers pushed by one pushsection when rebuilding a section
+   const static uint32_t min_section_remove = 50;     // blocks removed by one pushsection at least when rebuilding a section
    const static uint32_t prodsches_max_records = 5;
    const static uint32_t sections_max_records = 5;
    const static uint32_t producer_repetitions = 12;   // don't modify
@@ -37,11 +41,23 @@ namespace eosio {
    };
    typedef eosio::singleton< "global"_n, global_state > global_state_singleton;
 
+   // work-queue summary of the light client, so relays can decide what to push by reading table globalm only
+   struct chain_work_summary {
+      uint32_t    tip_block_num = 0;         // the last block header in table chaindb
+      uint64_t    last_section_first = 0;
+      uint64_t    last_section_last = 0;
+      bool        last_section_valid = false;
+
+      EOSLIB_SERIALIZE( chain_work_summary, (tip_block_num)(last_section_first)(last_section_last)(last_section_valid) )
+   };
+
    struct [[eosio::table("globalm"), eosio::contract("ibc.chain")]] global_mutable {
       global_mutable(){}
       uint32_t    last_anchor_block_num = 0;
+      binary_extension<chain_work_summary> work;   // refreshed at the end of the actions which change chaindb or sections
+      binary_extension<uint32_t>           stale_last;   // blocks of a rebuilt section left in chaindb above the last section, up to this number
 
-      EOSLIB_SERIALIZE( global_mutable, (last_anchor_block_num) )
+      EOSLIB_SERIALIZE( global_mutable, (last_anchor_block_num)(work)(stale_last) )
    };
    typedef eosio::singleton< "globalm"_n, global_mutable > global_mutable_singleton;
 
@@ -60,7 +76,7 @@ namespace eosio {
       EOSLIB_SERIALIZE( block_header_state, (block_num)(block_id)(header)(active_schedule_id)(pending_schedule_id)
                                             (blockroot_merkle)(block_signing_key)(is_anchor_block) )
    };
-   typedef eosio::multi_index< "chaindb"_n, block_header_state > chaindb;
+   typedef ibc_multi_index< "chaindb"_n, block_header_state > chaindb;
 
    struct [[eosio::table("prodsches"), eosio::contract("ibc.chain")]] producer_schedule_type {
       uint64_t                      id;
@@ -71,7 +87,7 @@ namespace eosio {
 
       EOSLIB_SERIALIZE( producer_schedule_type, (id)(schedule)(schedule_hash) )
    };
-   typedef eosio::multi_index< "prodsches"_n, producer_schedule_type >  prodsches;
+   typedef ibc_multi_index< "prodsches"_n, producer_schedule_type >  prodsches;
 
    struct [[eosio::table("sections"), eosio::contract("ibc.chain")]] section_type {
       uint64_t                first;
@@ -89,7 +105,7 @@ namespace eosio {
 
       EOSLIB_SERIALIZE( section_type, (first)(last)(newprod_block_num)(valid)(producers)(block_nums) )
    };
-   typedef eosio::multi_index< "sections"_n, section_type >  sections;
+   typedef ibc_multi_index< "sections"_n, section_type >  sections;
 
    struct [[eosio::table("relays"), eosio::contract("ibc.chain")]] relay_account {
       name    relay;
@@ -98,7 +114,31 @@ namespace eosio {
 
       EOSLIB_SERIALIZE( relay_account, (relay) )
    };
-   typedef eosio::multi_index< "relays"_n, relay_account > relays;
+   typedef ibc_multi_index< "relays"_n, relay_account > relays;
+
+   const static uint32_t max_relay_lease_seconds = 60;
+   const static uint32_t max_relay_lease_renewals = 10;   // then the lease must expire before its holder acquires it again
+
+   // a relay holding an unexpired lease is the only relay that can push its work type in its range,
+   // a relay holds at most one lease per work type, and unexpired leases of a work type never overlap
+   struct [[eosio::table("leases"), eosio::contract("ibc.chain")]] relay_lease {
+      uint64_t          id;
+      name              work;          // headers, cash or rollback
+      name              relay;
+      uint32_t          first;         // range of the leased work, see require_relay_lease
+      uint32_t          last;
+      time_point_sec    expiration;
+      uint32_t          renewals = 0;  // acquisitions by the holder before the lease expired, in a row
+
+      uint64_t primary_key()const { return id; }
+      uint64_t by_work()const { return work.value; }
+      bool overlaps( uint32_t f, uint32_t l )const { return first <= l && f <= last; }
+
+      EOSLIB_SERIALIZE( relay_lease, (id)(work)(relay)(first)(last)(expiration)(renewals) )
+   };
+   typedef ibc_multi_index< "leases"_n, relay_lease,
+      indexed_by<"work"_n, const_mem_fun<relay_lease, uint64_t, &relay_lease::by_work> >
+   > leases;
 
    struct [[eosio::table("wtmsig"), eosio::contract("ibc.chain")]] wtmsig_struct {
       bool              activated = false;
@@ -107,6 +147,12 @@ namespace eosio {
    };
    typedef eosio::singleton< "wtmsig"_n, wtmsig_struct > wtmsig_singleton;
 
+   struct [[eosio::table("events"), eosio::contract("ibc.chain")]] events_struct {
+      name              log_account;   // receives the ev* notifications, empty means no events are sent
+      EOSLIB_SERIALIZE( events_struct, (log_account))
+   };
+   typedef eosio::singleton< "events"_n, events_struct > events_singleton;
+
    class [[eosio::contract("ibc.chain")]] chain : public contract {
    private:
       global_state_singleton     _global_state;
@@ -117,10 +163,16 @@ namespace eosio {
       admin_struct               _admin_st;
       wtmsig_singleton           _wtmsig_sg;
       wtmsig_struct              _wtmsig_st;
+      events_singleton           _events_sg;
+      events_struct              _events_st;
+      uint32_t                   _ev_first_header = 0;   // range of the headers accepted by the current action
+      uint32_t                   _ev_last_header = 0;
+      bool                       _work_changed = false;  // set by the actions which change chaindb or sections
       chaindb                    _chaindb;
       prodsches                  _prodsches;
       sections                   _sections;
       relays                     _relays;
+      leases                     _leases;
 
    public:
       chain( name s, name code, datastream<const char*> ds );
@@ -136,6 +188,10 @@ namespace eosio {
       [[eosio::action]]
       void setadmin( name  admin );
 
+      // empty log_account turns the event notifications off
+      [[eosio::action]]
+      void setevents( name log_account );
+
       [[eosio::action]]
       void chaininit( const std::vector<char>&     header,
                       const producer_schedule&     active_schedule,
@@ -155,6 +211,10 @@ namespace eosio {
       [[eosio::action]]
       void relay( string action, name relay );
 
+      // lease work to relay for seconds, or release the lease of relay when seconds is 0
+      [[eosio::action]]
+      void acquirelease( name relay, name work, uint32_t first, uint32_t last, uint32_t seconds );
+
       // push a small batch of blocks and related commits, called by ibc plugin, used under batch consensus algorithm
       [[eosio::action]]
       void pushblkcmits( const std::vector<char>&    headers,
@@ -199,6 +259,21 @@ namespace eosio {
          }
       }
 
+      /**
+       * block_num of work "headers" is the first block number of pushsection or pushblkcmits,
+       * of work "cash" the orig_trx_block_num of the cash, and of work "rollback" always 0
+       */
+      static void require_relay_lease( name ibc_contract_account, name relay, name work, uint32_t block_num ) {
+         leases _leases( ibc_contract_account, ibc_contract_account.value );
+         auto idx = _leases.get_index<"work"_n>();
+         auto now = time_point_sec( current_time_point() );
+         for ( auto it = idx.lower_bound( work.value ); it != idx.end() && it->work == work; ++it ){
+            if ( it->relay != relay && now < it->expiration ){
+               eosio::check( ! it->overlaps( block_num, block_num ), ("work leased by relay " + it->relay.to_string()).c_str() );
+            }
+         }
+      }
+
       // this action maybe needed when repairing the ibc system manually
       [[eosio::action]]
       void forceinit( );
@@ -206,12 +281,25 @@ namespace eosio {
       [[eosio::action]]
       void reqrelayauth( );
 
+      // inline actions, notification only, the log account set by setevents receives them, used by trace based relays
+      [[eosio::action]]
+      void evheaders( uint32_t first, uint32_t last );   // headers accepted by one action
+
+      [[eosio::action]]
+      void evanchor( uint32_t block_num );
+
+      [[eosio::action]]
+      void evsection( uint64_t first, uint64_t last );   // section marked valid
+
    private:
       // pipeline pbft related
       void new_section( const signed_block_header& header, const incremental_merkle& blockroot_merkle );
       void append_header( const signed_block_header& header );
       uint32_t get_section_last_active_schedule_id( const section_type& section ) const;
-      bool remove_invalid_last_section( );
+      void drop_invalid_last_section();
+      bool remove_stale_blocks( uint32_t max_delete );   // returns true when no stale block is left
+      void update_work_summary();
+      void note_header_accepted( uint32_t block_num );
       void trim_last_section_or_not( );
 
       // batch pbft related
@@ -235,6 +323,13 @@ namespace eosio {
       bool only_one_eosio_bp();
 
       void check_admin_auth();
+      static void notify_log_account( name self );   // body of the ev* actions
+
+      template<typename... Args>
+      void emit_event( name event, Args&&... args ){
+         if ( _events_st.log_account == name() ){ return; }
+         send_inline( action( permission_level{ _self, "active"_n }, _self, event, std::make_tuple( std::forward<Args>(args)... ) ) );
+      }
 
       digest_type get_schedule_hash( producer_schedule new_producers );
    };
@@ -0,0 +1,300 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+
+#pragma once
+
+#include <vector>
+#include <eosiolib/contracts/eosio/action.hpp>
+#include <eosiolib/core/eosio/crypto.hpp>
+#include <eosiolib/contracts/eosio/multi_index.hpp>
+#include <eosiolib/core/eosio/print.hpp>
+
+/**
+ * per action cost accounting, compiled in only when IBC_INSTRUMENT is defined (build.sh argument INSTRUMENT=ON),
+ * never deploy an instrumented build to a production chain.
+ *
+ * tables declared with ibc_multi_index count reads and writes (emplace, modify, erase) with the packed size of the rows,
+ * of the table and of its secondary indexes. a read is a lookup (find, get, lower_bound, upper_bound), the start of an
+ * iteration (begin, rbegin) or an iterator step (++, --, also --end()), steps don't count bytes; ibc_sha256, ibc_assert_sha256, ibc_recover_key, ibc_assert_recover_key and send_inline
+ * count the crypto calls and inline actions. the contract destructors print the summary of the action as one json line.
+ * without IBC_INSTRUMENT all of them are plain aliases of the wrapped eosio functions.
+ */
+namespace eosio {
+
+#ifdef IBC_INSTRUMENT
+   namespace instrument {
+
+      struct table_counters {
+         uint64_t    table;
+         uint32_t    reads = 0;
+         uint32_t    writes = 0;
+         uint64_t    bytes_read = 0;
+         uint64_t    bytes_written = 0;
+      };
+
+      struct action_counters {
+         std::vector<table_counters>   tables;
+         uint32_t    sha256_calls = 0;
+         uint64_t    sha256_bytes = 0;
+         uint32_t    recover_key_calls = 0;
+         uint32_t    inline_actions = 0;
+         uint64_t    inline_bytes = 0;
+
+         table_counters& table( uint64_t table_name ){
+            for ( auto& t : tables ){
+               if ( t.table == table_name ){ return t; }
+            }
+            tables.push_back( table_counters{ table_name } );
+            return tables.back();
+         }
+      };
+
+      // every action runs in a fresh wasm instance, so the counters always start from zero
+      inline action_counters& counters(){
+         static action_counters c;
+         return c;
+      }
+
+      inline void print_summary(){
+         const auto& c = counters();
+         print( "{\"ibc_instrument\":{\"tables\":[" );
+         for ( size_t i = 0; i < c.tables.size(); ++i ){
+            const auto& t = c.tables[i];
+            print_f( "%{\"table\":\"%\",\"reads\":%,\"writes\":%,\"bytes_read\":%,\"bytes_written\":%}",
+                     i == 0 ? "" : ",", name(t.table), t.reads, t.writes, t.bytes_read, t.bytes_written );
+         }
+         print_f( "],\"sha256_calls\":%,\"sha256_bytes\":%,\"recover_key_calls\":%,\"inline_actions\":%,\"inline_bytes\":%}}\n",
+                  c.sha256_calls, c.sha256_bytes, c.recover_key_calls, c.inline_actions, c.inline_bytes );
+      }
+   }
+
+   namespace instrument {
+
+      // an iterator of a table or of one of its indexes, each step counts as a read of the table
+      template<name::raw TableName, typename Iterator>
+      class counted_iterator : public Iterator {
+      public:
+         counted_iterator() = default;
+         counted_iterator( const Iterator& itr ) : Iterator( itr ){}
+
+         counted_iterator& operator++(){
+            Iterator::operator++();
+            counters().table( static_cast<uint64_t>(TableName) ).reads += 1;
+            return *this;
+         }
+
+         counted_iterator& operator--(){
+            Iterator::operator--();
+            counters().table( static_cast<uint64_t>(TableName) ).reads += 1;
+            return *this;
+         }
+
+         counted_iterator operator++(int){
+            counted_iterator tmp = *this;
+            ++(*this);
+            return tmp;
+         }
+
+         counted_iterator operator--(int){
+            counted_iterator tmp = *this;
+            --(*this);
+            return tmp;
+         }
+      };
+   }
+
+   template<name::raw TableName, typename T, typename... Indices>
+   class ibc_multi_index : public multi_index<TableName, T, Indices...> {
+      using base = multi_index<TableName, T, Indices...>;
+
+      static void on_read( const T* obj ){
+         auto& t = instrument::counters().table( static_cast<uint64_t>(TableName) );
+         t.reads += 1;
+         if ( obj != nullptr ){ t.bytes_read += pack_size( *obj ); }
+      }
+
+      static void on_write( const T* obj ){
+         auto& t = instrument::counters().table( static_cast<uint64_t>(TableName) );
+         t.writes += 1;
+         if ( obj != nullptr ){ t.bytes_written += pack_size( *obj ); }
+      }
+
+      // a secondary index of the table, its lookups, steps and writes are counted as those of the table
+      template<typename Index>
+      class ibc_index : public Index {
+      public:
+         using const_iterator = instrument::counted_iterator<TableName, typename Index::const_iterator>;
+
+         ibc_index( const Index& idx ) : Index( idx ){}
+
+         const_iterator begin()const {
+            auto itr = Index::begin();
+            on_read( itr != Index::end() ? &*itr : nullptr );
+            return itr;
+         }
+
+         const_iterator end()const { return Index::end(); }
+
+         template<typename Key>
+         const_iterator find( const Key& key )const {
+            auto itr = Index::find( key );
+            on_read( itr != Index::end() ? &*itr : nullptr );
+            return itr;
+         }
+
+         template<typename Key>
+         const_iterator lower_bound( const Key& key )const {
+            auto itr = Index::lower_bound( key );
+            on_read( itr != Index::end() ? &*itr : nullptr );
+            return itr;
+         }
+
+         template<typename Key>
+         const_iterator upper_bound( const Key& key )const {
+            auto itr = Index::upper_bound( key );
+            on_read( itr != Index::end() ? &*itr : nullptr );
+            return itr;
+         }
+
+         template<typename Lambda>
+         void modify( const_iterator itr, name payer, Lambda&& updater ){
+            Index::modify( itr, payer, std::forward<Lambda>(updater) );
+            on_write( &*itr );
+         }
+
+         const_iterator erase( const_iterator itr ){
+            on_write( nullptr );
+            return Index::erase( itr );
+         }
+      };
+
+   public:
+      using base::base;
+      using const_iterator = instrument::counted_iterator<TableName, typename base::const_iterator>;
+      using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+      const_iterator begin()const {
+         auto itr = base::begin();
+         on_read( itr != base::end() ? &*itr : nullptr );
+         return itr;
+      }
+
+      const_iterator end()const { return base::end(); }
+
+      const_reverse_iterator rbegin()const { return std::make_reverse_iterator( end() ); }
+      const_reverse_iterator rend()const { return std::make_reverse_iterator( begin() ); }
+
+      const_iterator lower_bound( uint64_t primary )const {
+         auto itr = base::lower_bound( primary );
+         on_read( itr != base::end() ? &*itr : nullptr );
+         return itr;
+      }
+
+      const_iterator upper_bound( uint64_t primary )const {
+         auto itr = base::upper_bound( primary );
+         on_read( itr != base::end() ? &*itr : nullptr );
+         return itr;
+      }
+
+      const_iterator find( uint64_t primary )const {
+         auto itr = base::find( primary );
+         on_read( itr != base::end() ? &*itr : nullptr );
+         return itr;
+      }
+
+      const T& get( uint64_t primary, const char* error_msg = "unable to find key" )const {
+         const T& obj = base::get( primary, error_msg );
+         on_read( &obj );
+         return obj;
+      }
+
+      template<typename Lambda>
+      const_iterator emplace( name payer, Lambda&& constructor ){
+         auto itr = base::emplace( payer, std::forward<Lambda>(constructor) );
+         on_write( &*itr );
+         return itr;
+      }
+
+      template<typename Lambda>
+      void modify( const_iterator itr, name payer, Lambda&& updater ){
+         base::modify( itr, payer, std::forward<Lambda>(updater) );
+         on_write( &*itr );
+      }
+
+      template<typename Lambda>
+      void modify( const T& obj, name payer, Lambda&& updater ){
+         base::modify( obj, payer, std::forward<Lambda>(updater) );
+         on_write( &obj );
+      }
+
+      const_iterator erase( const_iterator itr ){
+         on_write( nullptr );
+         return base::erase( itr );
+      }
+
+      void erase( const T& obj ){
+         on_write( nullptr );
+         base::erase( obj );
+      }
+
+      template<name::raw IndexName>
+      auto get_index(){
+         using index_type = decltype( base::template get_index<IndexName>() );
+         return ibc_index<index_type>( base::template get_index<IndexName>() );
+      }
+
+      template<name::raw IndexName>
+      auto get_index()const {
+         using index_type = decltype( base::template get_index<IndexName>() );
+         return ibc_index<index_type>( base::template get_index<IndexName>() );
+      }
+   };
+#else
+   template<name::raw TableName, typename T, typename... Indices>
+   using ibc_multi_index = multi_index<TableName, T, Indices...>;
+#endif
+
+   template<typename... Args>
+   inline auto ibc_assert_sha256( const char* data, uint32_t length, Args&&... args ){
+#ifdef IBC_INSTRUMENT
+      instrument::counters().sha256_calls += 1;
+      instrument::counters().sha256_bytes += length;
+#endif
+      return assert_sha256( data, length, std::forward<Args>(args)... );
+   }
+
+   inline checksum256 ibc_sha256( const char* data, uint32_t length ){
+#ifdef IBC_INSTRUMENT
+      instrument::counters().sha256_calls += 1;
+      instrument::counters().sha256_bytes += length;
+#endif
+      return sha256( data, length );
+   }
+
+   template<typename... Args>
+   inline auto ibc_recover_key( Args&&... args ){
+#ifdef IBC_INSTRUMENT
+      instrument::counters().recover_key_calls += 1;
+#endif
+      return recover_key( std::forward<Args>(args)... );
+   }
+
+   template<typename... Args>
+   inline auto ibc_assert_recover_key( Args&&... args ){
+#ifdef IBC_INSTRUMENT
+      instrument::counters().recover_key_calls += 1;
+#endif
+      return assert_recover_key( std::forward<Args>(args)... );
+   }
+
+   inline void send_inline( const action& act ){
+#ifdef IBC_INSTRUMENT
+      instrument::counters().inline_actions += 1;
+      instrument::counters().inline_bytes += act.data.size();
+#endif
+      act.send();
+   }
+
+} /// namespace eosio
@@ -0,0 +1,35 @@
+/**
+ *  @file
+ *  @copyright defined in eos/LICENSE.txt
+ */
+
+#pragma once
+
+#include <eosiolib/core/eosio/print.hpp>
+
+/**
+ * compile-time log levels, set by build.sh argument LOG_LEVEL=<n> ( add_definitions(-DIBC_LOG_LEVEL=<n>) ).
+ * calls above the configured level are compiled out, their arguments are not evaluated.
+ *  0 none
+ *  1 info,  rare messages of manual or maintenance actions, such as forceinit (default)
+ *  2 debug, traces of every header added and every row deleted, never use in production builds
+ */
+#define IBC_LOG_LEVEL_NONE    0
+#define IBC_LOG_LEVEL_INFO    1
+#define IBC_LOG_LEVEL_DEBUG   2
+
+#ifndef IBC_LOG_LEVEL
+#define IBC_LOG_LEVEL IBC_LOG_LEVEL_INFO
+#endif
+
+#if IBC_LOG_LEVEL >= IBC_LOG_LEVEL_INFO
+#define IBC_LOG_INFO(...)  eosio::print_f( __VA_ARGS__ )
+#else
+#define IBC_LOG_INFO(...)  ((void)0)
+#endif
+
+#if IBC_LOG_LEVEL >= IBC_LOG_LEVEL_DEBUG
+#define IBC_LOG_DEBUG(...) eosio::print_f( __VA_ARGS__ )
+#else
+#define IBC_LOG_DEBUG(...) ((void)0)
+#endif
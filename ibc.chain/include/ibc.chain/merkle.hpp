@@ -20,7 +20,7 @@ namespace eosio {
    inline auto sha256hash(std::pair<digest_type,digest_type> pair_data){
       std::vector<char> buf = pack(pair_data);
       checksum256 hash;
-      assert_sha256( reinterpret_cast<char*>(buf.data()), buf.size(), hash );
+      ibc_assert_sha256( reinterpret_cast<char*>(buf.data()), buf.size(), hash );
       return hash;
    }
 
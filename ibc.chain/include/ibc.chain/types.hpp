@@ -5,8 +5,10 @@
 #pragma once
 
 #include <string>
+#include <cstring>
 #include <eosiolib/core/eosio/varint.hpp>
 #include <eosiolib/contracts/eosio/privileged.hpp>
+#include <ibc.chain/instrument.hpp>
 
 namespace eosio {
 
@@ -38,11 +40,35 @@ namespace eosio {
       datastream<char *> ds(result.data(), result.size());
       push(ds, args...);
       checksum256 digest;
-      assert_sha256(result.data(), result.size(), digest);
+      ibc_assert_sha256(result.data(), result.size(), digest);
       return digest;
    }
 
    inline bool is_equal_checksum256( checksum256 a, checksum256 b ){
       return a == b;
    }
+
+   /**
+    * transaction ids are indexed by their first 64 bits (idx64) instead of the whole 256 bits (idx256),
+    * rows with the same prefix are told apart by comparing the full id stored in the row.
+    */
+   inline uint64_t trx_id_prefix( const checksum256& id ){
+      uint64_t prefix = 0;
+      std::memcpy( &prefix, (const uint8_t*)id.data(), sizeof(prefix) );
+      return prefix;
+   }
+
+   // get_id returns the full transaction id of a row, returns idx.end() if not found
+   template<typename Index, typename Getter>
+   auto find_by_trx_id( const Index& idx, const checksum256& id, Getter get_id ){
+      auto prefix = trx_id_prefix( id );
+      auto itr = idx.lower_bound( prefix );
+      while ( itr != idx.end() && trx_id_prefix( get_id(*itr) ) == prefix ){
+         if ( get_id(*itr) == id ){
+            return itr;
+         }
+         ++itr;
+      }
+      return idx.end();
+   }
 }
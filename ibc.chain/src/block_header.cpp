@@ -33,7 +33,7 @@ namespace eosio {
    {
       std::vector<char> buf = pack(*this);
       checksum256 hash;
-      assert_sha256( reinterpret_cast<char*>(buf.data()), buf.size(), hash );
+      ibc_assert_sha256( reinterpret_cast<char*>(buf.data()), buf.size(), hash );
       return hash;
    }
 
@@ -55,6 +55,44 @@ namespace eosio {
       return u.result;
    }
 
+   headers_prefix read_headers_prefix( const std::vector<char>& headers_data )
+   {
+      datastream<const char*> ds( headers_data.data(), headers_data.size() );
+      unsigned_int count;
+      ds >> count;
+      eosio::check( count.value > 0, "headers can not be empty");
+
+      // timestamp, producer and confirmed come before previous
+      const size_t previous_offset = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint16_t);
+      eosio::check( ds.remaining() >= previous_offset + sizeof(block_id_type), "headers data too short");
+      ds.skip( previous_offset );
+
+      headers_prefix prefix;
+      prefix.count = count.value;
+      ds >> prefix.first_previous;
+      return prefix;
+   }
+
+   signed_block_header read_first_header( const std::vector<char>& headers_data )
+   {
+      datastream<const char*> ds( headers_data.data(), headers_data.size() );
+      unsigned_int count;
+      ds >> count;
+      eosio::check( count.value > 0, "headers can not be empty");
+
+      signed_block_header header;
+      ds >> header;
+      return header;
+   }
+
+   uint32_t read_vector_size( const std::vector<char>& data )
+   {
+      datastream<const char*> ds( data.data(), data.size() );
+      unsigned_int size;
+      ds >> size;
+      return size.value;
+   }
+
    std::optional<eosio::producer_schedule> block_header::get_ext_new_producers( uint16_t new_prd_ext_id ) const {
       for ( auto ext : header_extensions ){
          if ( std::get<0>(ext) == new_prd_ext_id ){
@@ -13,23 +13,36 @@ namespace eosio {
             _global_state(_self, _self.value),
             _admin_sg(_self, _self.value),
             _wtmsig_sg(_self, _self.value),
+            _events_sg(_self, _self.value),
             _global_mutable(_self, _self.value),
             _chaindb(_self, _self.value),
             _prodsches(_self, _self.value),
             _sections(_self, _self.value),
-            _relays(_self, _self.value)
+            _relays(_self, _self.value),
+            _leases(_self, _self.value)
    {
       _gstate = _global_state.exists() ? _global_state.get() : global_state{};
       _gmutable = _global_mutable.exists() ? _global_mutable.get() : global_mutable{};
       _admin_st = _admin_sg.exists() ? _admin_sg.get() : admin_struct{};
       _wtmsig_st = _wtmsig_sg.exists() ? _wtmsig_sg.get() : wtmsig_struct{};
+      _events_st = _events_sg.exists() ? _events_sg.get() : events_struct{};
    }
 
    chain::~chain() {
+      if ( _work_changed ){
+         update_work_summary();
+      }
+      if ( _ev_last_header != 0 ){
+         emit_event( "evheaders"_n, _ev_first_header, _ev_last_header );
+      }
       _global_state.set( _gstate, _self );
       _global_mutable.set( _gmutable, _self );
       _admin_sg.set( _admin_st , _self );
       _wtmsig_sg.set( _wtmsig_st , _self );
+      _events_sg.set( _events_st , _self );
+      #ifdef IBC_INSTRUMENT
+      instrument::print_summary();
+      #endif
    }
 
    ACTION chain::setglobal( name              chain_name,
@@ -54,11 +67,18 @@ namespace eosio {
       _admin_st.admin = admin;
    }
 
+   ACTION chain::setevents( name log_account ){
+      check_admin_auth();
+      eosio::check( log_account == name() || is_account(log_account), "log_account is not exist");
+      _events_st.log_account = log_account;
+   }
+
    // init for both pipeline and batch light client
    ACTION chain::chaininit( const std::vector<char>&      header_data,
                           const producer_schedule&      active_schedule,
                           const incremental_merkle&     blockroot_merkle,
                           const name&                   relay ) {
+      _work_changed = true;
       if ( has_auth(_self) ){
          while ( _chaindb.begin() != _chaindb.end() ){ _chaindb.erase(_chaindb.begin()); }
          while ( _prodsches.begin() != _prodsches.end() ){ _prodsches.erase(_prodsches.begin()); }
@@ -117,6 +137,7 @@ namespace eosio {
       _sections.emplace( _self, [&]( auto& r ) {
          r = std::move( sct );
       });
+      note_header_accepted( header_block_num );
    }
 
 
@@ -126,29 +147,49 @@ namespace eosio {
                             const incremental_merkle&   blockroot_merkle,
                             const name&                 relay ) {
       require_relay_auth( _self, relay );
+      _work_changed = true;
 
       eosio::check( _gstate.consensus_algo == "pipeline"_n, "consensus algorithm must be pipeline");
 
-      std::vector<signed_block_header> headers = unpack<std::vector<signed_block_header>>( headers_data );
       eosio::check( _sections.begin() != _sections.end(), "the light client has not been initialized yet");
       const auto& last_section = *(_sections.rbegin());
 
-      uint32_t front_block_num = headers.front().block_num();
+      // checks with the leading bytes only, racing relays pushing the same blocks fail before the batch is unpacked
+      auto prefix = read_headers_prefix( headers_data );
+      uint32_t front_block_num = prefix.first_block_num();
+      require_relay_lease( _self, relay, "headers"_n, front_block_num );
       eosio::check ( front_block_num >= last_section.first, "front_block_num >= last_section.first must be true");
 
+      // a section is ingested in chunks of any size, the section record is the cursor of the verified headers,
+      // the next chunk starts at its last + 1 (or earlier to switch fork), nothing verified is verified again
+      // blocks of a rebuilt section are removed with the work of this action left by the headers, a smaller chunk removes more blocks
+      uint32_t max_remove = std::max( max_section_work - std::min( prefix.count, max_section_work ), min_section_remove );
       bool create_section = false;
       if ( front_block_num > last_section.last + 1 ) {      // create new section
          eosio::check( last_section.valid , "last section must be completed first");
+         // stale blocks below the new section would never be replaced, so they go first
+         if ( ! remove_stale_blocks( max_remove )){ return; }
          create_section = true;
       }
       else if ( front_block_num == last_section.first ) {   // delete old and create new section
-         eosio::check( ! is_equal_checksum256(headers.front().id(), _chaindb.get( front_block_num ).block_id), "first block header repeated");
-         if ( ! remove_invalid_last_section()){ return; }
+         eosio::check( ! is_equal_checksum256(read_first_header( headers_data ).id(), _chaindb.get( front_block_num ).block_id), "first block header repeated");
+
+         // the chunk replaces the old blocks it covers and is pushed in this action,
+         // the old blocks above it are left to stale_last of table globalm and removed below and by the next actions
+         drop_invalid_last_section();
          create_section = true;
       }
+      else {                                                // append to the last section
+         eosio::check( front_block_num <= last_section.last + 1, "unlinkable block" );
+         eosio::check( _chaindb.get( front_block_num - 1 ).block_id == prefix.first_previous, "unlinkable block" );
+         if ( front_block_num <= last_section.last ){
+            eosio::check( read_first_header( headers_data ).id() != _chaindb.get( front_block_num ).block_id,
+                          ("block repeated: " + std::to_string(front_block_num)).c_str() );
+         }
+      }
 
+      std::vector<signed_block_header> headers = unpack<std::vector<signed_block_header>>( headers_data );
       if ( create_section ){
-         eosio::check( headers.size() >= 30, "new section's size must not less then 30");
          new_section( headers.front(), blockroot_merkle );
          headers.erase( headers.begin() );
       }
@@ -157,6 +198,8 @@ namespace eosio {
          append_header( header );
       }
 
+      remove_stale_blocks( max_remove );
+
       // mark anchor block
       auto ls = *(_sections.rbegin());
       if ( !ls.valid ){ return; }
@@ -167,6 +210,7 @@ namespace eosio {
             r.is_anchor_block = true;
          });
          _gmutable.last_anchor_block_num = anchor_block_num;
+         emit_event( "evanchor"_n, anchor_block_num );
       }
    }
 
@@ -224,7 +268,8 @@ namespace eosio {
          r = std::move( sct );
       });
 
-      print_f("-- new section block added: % --", header_block_num);
+      note_header_accepted( header_block_num );
+      IBC_LOG_DEBUG("-- new section block added: % --", header_block_num);
    }
 
 
@@ -276,7 +321,7 @@ namespace eosio {
             _chaindb.erase( --_chaindb.end() );
          }
 
-         print_f("-- block deleted: from % back to % --", last_section_last, header_block_num);
+         IBC_LOG_DEBUG("-- block deleted: from % back to % --", last_section_last, header_block_num);
       }
 
       // verify linkable
@@ -310,6 +355,7 @@ namespace eosio {
             _sections.modify( last_section, same_payer, [&]( auto& r ) {
                r.valid = true;
             });
+            emit_event( "evsection"_n, last_section.first, last_section.last );
          }
 
          bhs.active_schedule_id  = last_bhs.active_schedule_id;
@@ -391,39 +437,56 @@ namespace eosio {
 
       trim_last_section_or_not();
 
-      print_f("-- block added: % --", header_block_num);
+      note_header_accepted( header_block_num );
+      IBC_LOG_DEBUG("-- block added: % --", header_block_num);
    }
 
    uint32_t chain::get_section_last_active_schedule_id( const section_type& section ) const {
       return _chaindb.get( section.last ).active_schedule_id;
    }
 
-   bool chain::remove_invalid_last_section( ){
-      const static uint32_t max_delete = 50;
-
+   void chain::drop_invalid_last_section(){
       auto it = --_sections.end();
       eosio::check( false == it->valid, "last section is valid, can't remove");
 
-      bool finished = max_delete >= (it->last - it->first + 1) ? true : false;
-      for( uint64_t num = std::max(it->first, it->last - max_delete + 1); num <= it->last; ++num ){
-         auto existing = _chaindb.find( num );
-         if ( existing != _chaindb.end() ){
-            _chaindb.erase( existing );
-         }
-      }
+      _gmutable.stale_last.emplace( std::max( uint32_t(it->last), _gmutable.stale_last.value_or( 0 ) ));
+      _sections.erase( it );
+   }
 
-      if ( finished ){
-         _sections.erase( it );
-      } else {
-         _sections.modify( it, same_payer, [&]( auto& r ) {
-            r.last = it->last - max_delete;
-            r.clear_from( it->last - max_delete + 1 );
-         });
+   bool chain::remove_stale_blocks( uint32_t max_delete ){
+      uint32_t stale_last = _gmutable.stale_last.value_or( 0 );
+      if ( stale_last == 0 ){ return true; }
+
+      // the blocks up to the last section's last are its own, the stale ones below them were replaced
+      uint32_t last_section_last = _sections.rbegin()->last;
+      for ( uint32_t count = 0; stale_last > last_section_last && count < max_delete; ++count ){
+         remove_header_if_exist( stale_last-- );
       }
 
+      bool finished = stale_last <= last_section_last;
+      _gmutable.stale_last.emplace( finished ? 0 : stale_last );
       return finished;
    }
 
+   void chain::update_work_summary(){
+      chain_work_summary work;
+      if ( _chaindb.begin() != _chaindb.end() ){
+         work.tip_block_num = (--_chaindb.end())->block_num;
+      }
+      if ( _sections.begin() != _sections.end() ){
+         const auto& last_section = *(--_sections.end());
+         work.last_section_first = last_section.first;
+         work.last_section_last  = last_section.last;
+         work.last_section_valid = last_section.valid;
+      }
+      _gmutable.work.emplace( work );
+   }
+
+   void chain::note_header_accepted( uint32_t block_num ){
+      if ( _ev_first_header == 0 ){ _ev_first_header = block_num; }
+      _ev_last_header = block_num;
+   }
+
    void chain::remove_header_if_exist( uint32_t block_num ){
       auto existing = _chaindb.find( block_num );
       if ( existing != _chaindb.end() ){
@@ -460,6 +523,7 @@ namespace eosio {
    static const uint32_t max_delete = 150; // max delete 150 records per time, in order to avoid exceed cpu limit
    ACTION chain::rmfirstsctn( const name& relay ){
       require_relay_auth( _self, relay );
+      _work_changed = true;
 
       auto it = _sections.begin();
       auto next = ++it;
@@ -472,7 +536,7 @@ namespace eosio {
          for ( uint32_t num = begin->first; num < begin->first + max_delete; ++num ){
             auto it = _chaindb.find( num );
             if ( it != _chaindb.end() && !it->is_anchor_block ){
-               print("-- delete block1 --");print( num );
+               IBC_LOG_DEBUG("-- delete block1: % --", num);
                _chaindb.erase( it );
             }
          }
@@ -490,7 +554,7 @@ namespace eosio {
          for ( uint32_t num = begin->first; num <= begin->last; ++num ){
             auto it = _chaindb.find( num );
             if ( it != _chaindb.end() && !it->is_anchor_block ){
-               print("-- delete block2 --");print( num );
+               IBC_LOG_DEBUG("-- delete block2: % --", num);
                _chaindb.erase( it );
             }
          }
@@ -510,8 +574,8 @@ namespace eosio {
       while ( count++ <= max_delete ){
          auto itr = _chaindb.begin();
          if ( itr->block_num < end_block_num - chaindb_max_history_length * 120 ){
+            IBC_LOG_DEBUG("-- delete block3: % --", itr->block_num);
             _chaindb.erase( itr );
-            print("-- delete block3 --");print(itr->block_num);
          } else { break; }
       }
    }
@@ -604,31 +668,34 @@ namespace eosio {
                              const name&                 proof_type,
                              const name&                 relay ) {
       require_relay_auth( _self, relay );
+      _work_changed = true;
 
       eosio::check( _gstate.consensus_algo == "batch"_n, "consensus algorithm must be batch");
       eosio::check( _chaindb.begin() != _chaindb.end(), "the light client has not been initialized yet");
 
-      // unpack and make basic assert
-      std::vector<signed_block_header> headers = unpack<std::vector<signed_block_header>>( headers_data );
-      eosio::check( _chaindb.find( headers.front().block_num() ) == _chaindb.end(), "the first block header aready exist");
+      // basic asserts with the leading bytes only, racing relays pushing the same blocks fail before anything is unpacked
+      auto prefix = read_headers_prefix( headers_data );
+      require_relay_lease( _self, relay, "headers"_n, prefix.first_block_num() );
+      eosio::check( _chaindb.find( prefix.first_block_num() ) == _chaindb.end(), "the first block header aready exist");
+      eosio::check( proof_type == "commit"_n || proof_type == "checkpoint"_n, "invalid proof_type name");
+      eosio::check( blockroot_merkle._node_count != 0 && blockroot_merkle._active_nodes.size() != 0, "blockroot_merkle can not be empty");
+
+      uint32_t proof_size = read_vector_size( proof_data );
+      if ( ! only_one_eosio_bp() ){
+         eosio::check( proof_size >= 15, "size of proof must not less then 15");
+      }
+      eosio::check( proof_size <= 40, "size of proof too large");
 
+      // unpack
+      std::vector<signed_block_header> headers = unpack<std::vector<signed_block_header>>( headers_data );
       std::vector<pbft_commit> commits;
       std::vector<pbft_checkpoint> checkpoints;
       if ( proof_type == "commit"_n ){
          commits = unpack<std::vector<pbft_commit>>( proof_data );
-      } else if ( proof_type == "checkpoint"_n ){
+      } else {
          checkpoints = unpack<std::vector<pbft_checkpoint>>( proof_data );
-      } else { eosio::check( false, "invalid proof_type name"); }
-
-      eosio::check( headers.size() > 0, "headers can not be empty");
-      eosio::check( blockroot_merkle._node_count != 0 && blockroot_merkle._active_nodes.size() != 0, "blockroot_merkle can not be empty");
-
-      if ( ! only_one_eosio_bp() ){
-         eosio::check( commits.size() >= 15 || checkpoints.size() >= 15, "size of proof must not less then 15");
       }
 
-      eosio::check( commits.size() <= 40 && checkpoints.size() <= 40, "size of proof too large");
-
       uint32_t first_num = headers.front().block_num();
       uint32_t last_num = headers.back().block_num();
 
@@ -707,8 +774,8 @@ namespace eosio {
          auto itr = _chaindb.begin();
          uint32_t range_length = chaindb_max_history_length * 120;
          if ( end_block_num > range_length && itr->block_num < end_block_num - range_length ){
+            IBC_LOG_DEBUG("-- delete block: % --", itr->block_num);
             _chaindb.erase( itr );
-            print("-- delete block --");print(itr->block_num);
          } else { break; }
       }
    }
@@ -786,6 +853,7 @@ namespace eosio {
          // update last_anchor_block_num
          eosio::check( header_block_num > _gmutable.last_anchor_block_num, "assert header_block_num > _gmutable.last_anchor_block_num failed");
          _gmutable.last_anchor_block_num = header_block_num;
+         emit_event( "evanchor"_n, header_block_num );
       } else {
          eosio::check( header_block_num == last_bhs.block_num + 1, "assert header_block_num == last_bhs.block_num + 1 failed");
          last_bhs.blockroot_merkle.append( last_bhs.block_id );
@@ -810,7 +878,8 @@ namespace eosio {
          r = std::move(bhs);
       });
 
-      print_f("-- block added: % --", header_block_num);
+      note_header_accepted( header_block_num );
+      IBC_LOG_DEBUG("-- block added: % --", header_block_num);
    }
 
    // ------ common functions ------ //
@@ -823,8 +892,8 @@ namespace eosio {
    }
 
    public_key chain::get_public_key_form_signature( digest_type digest, signature_type sig ) const {
-      public_key pub_key = recover_key( digest, sig );
-      assert_recover_key(digest, sig, pub_key);
+      public_key pub_key = ibc_recover_key( digest, sig );
+      ibc_assert_recover_key(digest, sig, pub_key);
       // eosio::check( pubkey_size == 34, "pubkey_size != 34");
       return pub_key;
    }
@@ -862,13 +931,14 @@ namespace eosio {
    void chain::assert_producer_signature(const digest_type& digest,
                                          const signature& signature,
                                          const public_key& pub_key ) const {
-      assert_recover_key( digest, signature, pub_key );
+      ibc_assert_recover_key( digest, signature, pub_key );
    }
 
    // ------ force init ------ //
 
    ACTION chain::forceinit(){
       check_admin_auth();
+      _work_changed = true;
       while ( _prodsches.begin() != _prodsches.end() ){ _prodsches.erase(_prodsches.begin()); }
       while ( _sections.begin() != _sections.end() ){ _sections.erase(_sections.begin()); }
       _gmutable = global_mutable{};
@@ -881,9 +951,9 @@ namespace eosio {
       }
 
       if( _chaindb.begin() == _chaindb.end() ){
-         print_f("force initialization completed");
+         IBC_LOG_INFO("force initialization completed");
       } else {
-         print_f("force initialization is not complete, please call forceinit() again");
+         IBC_LOG_INFO("force initialization is not complete, please call forceinit() again");
       }
    }
 
@@ -915,6 +985,59 @@ namespace eosio {
       eosio::check(false,"unknown action");
    }
 
+   /**
+    * a relay acquires a lease before pushing a range of work, other relays back off from that range until it expires,
+    * so the work fails over to them automatically when the holder stops. other relays can lease disjoint ranges.
+    * the holder renews its lease by acquiring it again before it expires, at most max_relay_lease_renewals times in a row.
+    */
+   ACTION chain::acquirelease( name relay, name work, uint32_t first, uint32_t last, uint32_t seconds ) {
+      require_auth( relay );
+      require_relay_auth( _self, relay );
+      eosio::check( work == "headers"_n || work == "cash"_n || work == "rollback"_n, "work must be headers, cash or rollback");
+      eosio::check( first <= last, "first must not greater then last");
+      eosio::check( seconds <= max_relay_lease_seconds, "lease seconds must not greater then max_relay_lease_seconds");
+
+      auto now = time_point_sec( current_time_point() );
+      auto idx = _leases.get_index<"work"_n>();
+      auto own = idx.end();
+      for ( auto it = idx.lower_bound( work.value ); it != idx.end() && it->work == work; ++it ){
+         if ( it->relay == relay ){
+            own = it;
+         } else if ( seconds != 0 && now < it->expiration ){
+            eosio::check( ! it->overlaps( first, last ), ("work leased by relay " + it->relay.to_string()).c_str() );
+         }
+      }
+
+      if ( seconds == 0 ){
+         if ( own != idx.end() ){
+            idx.erase( own );
+         }
+         return;
+      }
+
+      if ( own == idx.end() ){
+         auto id = _leases.available_primary_key();
+         _leases.emplace( _self, [&]( auto& r ){
+            r.id           = id;
+            r.work         = work;
+            r.relay        = relay;
+            r.first        = first;
+            r.last         = last;
+            r.expiration   = now + seconds;
+            r.renewals     = 0;
+         });
+      } else {
+         bool renewal = now < own->expiration;
+         eosio::check( ! renewal || own->renewals < max_relay_lease_renewals, "max_relay_lease_renewals exceed, the lease must expire first");
+         idx.modify( own, same_payer, [&]( auto& r ){
+            r.first        = first;
+            r.last         = last;
+            r.expiration   = now + seconds;
+            r.renewals     = renewal ? r.renewals + 1 : 0;
+         });
+      }
+   }
+
    ACTION chain::reqrelayauth( ){
       if ( check_relay_auth ){
          eosio::check( false, "check_relay_auth == true" );
@@ -923,6 +1046,28 @@ namespace eosio {
       }
    }
 
+   // the ev* actions are dispatched to notify_log_account by apply() without constructing the contract,
+   // these bodies only define their abi
+   ACTION chain::evheaders( uint32_t first, uint32_t last ){
+      notify_log_account( _self );
+   }
+
+   ACTION chain::evanchor( uint32_t block_num ){
+      notify_log_account( _self );
+   }
+
+   ACTION chain::evsection( uint64_t first, uint64_t last ){
+      notify_log_account( _self );
+   }
+
+   void chain::notify_log_account( name self ){
+      require_auth( self );
+      events_singleton events_sg( self, self.value );
+      if ( events_sg.exists() && events_sg.get().log_account != name() ){
+         require_recipient( events_sg.get().log_account );
+      }
+   }
+
    void chain::check_admin_auth(){
       if ( ! has_auth(_self) ){
          eosio::check( _admin_st.admin != name() && is_account( _admin_st.admin ),"admin account not exist");
@@ -954,4 +1099,19 @@ namespace eosio {
 
 } /// namespace eosio
 
-// EOSIO_DISPATCH( eosio::chain, (setglobal)(chaininit)(pushsection)(rmfirstsctn)(pushblkcmits)(forceinit)(relay)(reqrelayauth)(setadmin) )
+extern "C" {
+   void apply( uint64_t receiver, uint64_t code, uint64_t action ) {
+      if( code == receiver ) {
+         switch( action ) {
+            // an event is an inline action to _self, constructing the contract for it would read and write all singletons
+            case eosio::name("evheaders").value:
+            case eosio::name("evanchor").value:
+            case eosio::name("evsection").value:
+               eosio::chain::notify_log_account( eosio::name(receiver) );
+               break;
+            EOSIO_DISPATCH_HELPER( eosio::chain, (setglobal)(setadmin)(setevents)(chaininit)(pushsection)(rmfirstsctn)
+            (relay)(acquirelease)(pushblkcmits)(forceinit)(reqrelayauth) )
+         }
+      }
+   }
+}
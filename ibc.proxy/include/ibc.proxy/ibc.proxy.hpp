@@ -34,18 +34,54 @@ namespace eosio {
       [[eosio::action]]
       void transfer( name from, name to, asset quantity, string memo );
 
+      // forward many records of one token to one peer chain in one transaction, it must be the only action of the transaction,
+      // items[i] and orig_froms[i] must match record ids[i], see forwardbatch_action_type of ibc.token
+      [[eosio::action]]
+      void forwardbatch( name from, name peerchain_name, const std::vector<bundle_item>& items,
+                         const std::vector<uint64_t>& ids, const std::vector<name>& orig_froms );
+
       [[eosio::action]]
       void mvtotrash( transaction_id_type orig_trx_id );
 
+      // compact at most max_rows records of table proxytrxs2 older than trash_ttl into table proxyarch, can be called by anyone
+      [[eosio::action]]
+      void compacttrash( uint32_t max_rows );
+
+      [[eosio::action]]
+      void setevents( name log_account );
+
+      // add token_contract to table whitelist if it's registered in table accepts of ibc.token, remove it otherwise,
+      // can be called by anyone
+      [[eosio::action]]
+      void syncwhitelist( name token_contract );
+
+      // inline action, notification only, the full record of table proxytrxs2 removed by compacttrash
+      [[eosio::action]]
+      void evtrash( uint64_t id, const transaction_id_type& orig_trx_id, uint64_t block_time_slot, name token_contract,
+                    name orig_from, const asset& quantity, const string& orig_memo );
+
       struct [[eosio::table("globals")]] global_state {
          global_state(){}
          name              ibc_token_account;
          EOSLIB_SERIALIZE( global_state, (ibc_token_account))
       };
 
+      struct [[eosio::table("events")]] events_struct {
+         name              log_account;   // receives the ev* notifications, empty means no events are sent
+         EOSLIB_SERIALIZE( events_struct, (log_account))
+      };
+
    private:
       eosio::singleton< "globals"_n, global_state >   _global_state;
       global_state                                    _gstate;
+      eosio::singleton< "events"_n, events_struct >   _events_sg;
+      events_struct                                   _events_st;
+
+      template<typename... Args>
+      void emit_event( name event, Args&&... args ){
+         if ( _events_st.log_account == name() ){ return; }
+         send_inline( action( permission_level{ _self, "active"_n }, _self, event, std::make_tuple( std::forward<Args>(args)... ) ) );
+      }
 
       // use to record accepted ibc transactions
       // code,scope(_self,_self.value)
@@ -60,16 +96,44 @@ namespace eosio {
          string                  orig_memo;
 
          uint64_t primary_key()const { return id; }
-         fixed_bytes<32> by_trx_id()const { return fixed_bytes<32>(orig_trx_id); }
+         uint64_t by_trx_id()const { return trx_id_prefix(orig_trx_id); }
       };
-      eosio::multi_index< "proxytrxs"_n, proxy_trx_info,
-      indexed_by<"trxid"_n, const_mem_fun<proxy_trx_info, fixed_bytes<32>, &proxy_trx_info::by_trx_id> >
+      ibc_multi_index< "proxytrxs"_n, proxy_trx_info,
+      indexed_by<"trxid"_n, const_mem_fun<proxy_trx_info, uint64_t, &proxy_trx_info::by_trx_id> >
       > _proxytrxs;
 
-      eosio::multi_index< "proxytrxs2"_n, proxy_trx_info,
-      indexed_by<"trxid"_n, const_mem_fun<proxy_trx_info, fixed_bytes<32>, &proxy_trx_info::by_trx_id> >
+      ibc_multi_index< "proxytrxs2"_n, proxy_trx_info,
+      indexed_by<"trxid"_n, const_mem_fun<proxy_trx_info, uint64_t, &proxy_trx_info::by_trx_id> >
       > _proxytrxs2;
 
+      // token contracts registered in table accepts of ibc.token, synced by syncwhitelist
+      // code,scope(_self,_self.value)
+      struct [[eosio::table]] whitelist_entry {
+         name                    token_contract;
+
+         uint64_t primary_key()const { return token_contract.value; }
+      };
+      ibc_multi_index< "whitelist"_n, whitelist_entry > _whitelist;
+
+      const static uint64_t trash_ttl = 3600*2*24*30; // in block time slots, 30 days
+
+      // compacted records of table proxytrxs2
+      // code,scope(_self,_self.value)
+      struct [[eosio::table]] proxy_trx_archive {
+         uint64_t                id;
+         uint64_t                trash_id;         // id of the proxytrxs2 record, which may have been reused by a later record
+         uint64_t                orig_trx_id_prefix;
+         name                    token_contract;
+         asset                   quantity;
+         checksum256             memo_hash;        // sha256 of orig_memo, the full record is in event evtrash
+
+         uint64_t primary_key()const { return id; }
+         uint64_t by_trx_id()const { return orig_trx_id_prefix; }
+      };
+      ibc_multi_index< "proxyarch"_n, proxy_trx_archive,
+      indexed_by<"trxid"_n, const_mem_fun<proxy_trx_archive, uint64_t, &proxy_trx_archive::by_trx_id> >
+      > _proxyarch;
+
    };
 
 } /// namespace eosio
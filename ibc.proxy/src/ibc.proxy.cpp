@@ -15,13 +15,21 @@ namespace eosio {
          contract( s, code, ds ),
          _global_state( _self, _self.value ),
          _proxytrxs( _self, _self.value ),
-         _proxytrxs2( _self, _self.value )
+         _proxytrxs2( _self, _self.value ),
+         _events_sg( _self, _self.value ),
+         _proxyarch( _self, _self.value ),
+         _whitelist( _self, _self.value )
    {
       _gstate = _global_state.exists() ? _global_state.get() : global_state{};
+      _events_st = _events_sg.exists() ? _events_sg.get() : events_struct{};
    }
 
    proxy::~proxy(){
       _global_state.set( _gstate, _self );
+      _events_sg.set( _events_st, _self );
+      #ifdef IBC_INSTRUMENT
+      instrument::print_summary();
+      #endif
     }
    
    void proxy::setglobal(  name ibc_token_account ) {
@@ -31,8 +39,8 @@ namespace eosio {
 
    void proxy::transfer_notify( name token_contract, name from, name to, asset quantity, string memo ){
       if( token_contract != _gstate.ibc_token_account ){
-         eosio::check(token::token_contract_registered_in_accepts(_gstate.ibc_token_account,token_contract),
-               "token contract not registered in table 'accepts' of ibc.token contract");
+         eosio::check( _whitelist.find( token_contract.value ) != _whitelist.end(),
+               "token contract not in table 'whitelist', registered in table 'accepts' of ibc.token contract and synced by syncwhitelist");
       }
 
       eosio::check( to == _self, "to must be the proxy contract account self");
@@ -60,12 +68,13 @@ namespace eosio {
 
       eosio::check( from == _self, "from must be _self");
 
-      string orig_trxid_str = get_value_str_by_key_str( memo, key_orig_trxid );
-      eosio::check( ! orig_trxid_str.empty(), ("key: " + key_orig_trxid + " not exist in memo string").c_str());
-      checksum256 orig_trx_id = string_to_checksum256( orig_trxid_str );
+      memo_info_type info;
+      get_memo_values( memo, info );
+      eosio::check( ! info.orig_trxid.empty(), ("key: " + key_orig_trxid + " not exist in memo string").c_str());
+      checksum256 orig_trx_id = memo_value_to_checksum256( info, info.orig_trxid );
 
       auto idx = _proxytrxs.get_index<"trxid"_n>();
-      const auto& trx_p = idx.find(fixed_bytes<32>(orig_trx_id));
+      const auto& trx_p = find_by_trx_id( idx, orig_trx_id, []( const auto& r ){ return r.orig_trx_id; } );
       eosio::check( trx_p != idx.end(), "transaction not found.");
       eosio::check( quantity == trx_p->quantity, "quantity == trx_p->quantity assert failed");
 
@@ -73,55 +82,160 @@ namespace eosio {
          eosio::check( get_block_time_slot() - trx_p->block_time_slot > 240, "you can't rollback proxy transaction within two minutes");
          string rollback_memo = "rollback transaction: " + checksum256_to_string(orig_trx_id);
          transfer_action_type action_data{ from, to, quantity, rollback_memo };
-         action( permission_level{ _self, "active"_n }, trx_p->token_contract, "transfer"_n, action_data ).send();
+         send_inline( action( permission_level{ _self, "active"_n }, trx_p->token_contract, "transfer"_n, action_data ) );
          _proxytrxs.erase( *trx_p );
          return;
       }
 
       eosio::check( to == _gstate.ibc_token_account, "to must be ibc_token_account");
 
-      name orig_from = name( get_value_str_by_key_str( memo, key_orig_from ));
+      name orig_from = memo_value_to_name( info, info.orig_from );
       eosio::check( orig_from != name(), ("key: " + key_orig_from + " not exist in memo string").c_str());
       eosio::check( orig_from == trx_p->orig_from, "orig_from == trx_p->from assert failed");
 
-      eosio::check( memo.find(trx_p->orig_memo) == 0, "memo sting must start with user's original memo string");
-
-      string correct_memo_str = trx_p->orig_memo + " " +
-            key_orig_trxid + "=" + checksum256_to_string(trx_p->orig_trx_id) + " " +
-            key_orig_from + "=" + trx_p->orig_from.to_string();
+      // a binary original memo is forwarded as a binary memo with the orig trx id and orig_from fields filled
+      string correct_memo_str;
+      if ( is_memo_v2( trx_p->orig_memo ) ){
+         auto orig_info = get_memo_info( trx_p->orig_memo );
+         correct_memo_str = encode_memo_v2( orig_info.receiver, orig_info.peerchain, orig_info.notes, &trx_p->orig_trx_id, trx_p->orig_from );
+      } else {
+         eosio::check( memo.find(trx_p->orig_memo) == 0, "memo sting must start with user's original memo string");
+         correct_memo_str = trx_p->orig_memo + " " +
+               key_orig_trxid + "=" + checksum256_to_string(trx_p->orig_trx_id) + " " +
+               key_orig_from + "=" + trx_p->orig_from.to_string();
+      }
 
       eosio::check( memo == correct_memo_str, "memo != correct_memo_str");
 
       transfer_action_type action_data{ from, to, quantity, memo };
-      action( permission_level{ _self, "active"_n }, trx_p->token_contract, "transfer"_n, action_data ).send();
+      send_inline( action( permission_level{ _self, "active"_n }, trx_p->token_contract, "transfer"_n, action_data ) );
 
       _proxytrxs.erase( *trx_p );
    }
 
+   /**
+    * the records are looked up by primary key and erased, then their total is transferred to ibc.token in one action
+    * with memo proxy_batch_memo, ibc.token reads the items and original senders from this action's data.
+    * can be pushed by anyone, every item is checked against its record.
+    */
+   void proxy::forwardbatch( name from, name peerchain_name, const std::vector<bundle_item>& items,
+                             const std::vector<uint64_t>& ids, const std::vector<name>& orig_froms ){
+
+      // ibc.token requires this action to be the only one of its transaction, checked here before any record is erased
+      {
+         std::vector<char> trx_bytes;
+         size_t trx_size = transaction_size();
+         trx_bytes.resize(trx_size);
+         read_transaction(trx_bytes.data(), trx_size);
+         auto trx = unpack<transaction>(trx_bytes.data(), trx_size);
+         eosio::check( trx.actions.size() == 1, "forwardbatch must be the only action of its transaction");
+         eosio::check( trx.actions.front().account == _self && trx.actions.front().name == "forwardbatch"_n, "inline forwardbatch not supported");
+      }
+
+      eosio::check( from == _self, "from must be _self");
+      eosio::check( 0 < ids.size() && ids.size() <= max_bundle_items, "ids count must in range [1,50]");
+      eosio::check( items.size() == ids.size() && orig_froms.size() == ids.size(), "items, ids and orig_froms must have the same size");
+
+      name token_contract;
+      asset total( 0, items.front().quantity.symbol );
+      for ( size_t i = 0; i < ids.size(); ++i ){
+         const auto& trx = _proxytrxs.get( ids[i], "transaction not found.");
+         if ( i == 0 ){
+            token_contract = trx.token_contract;
+         }
+         eosio::check( trx.token_contract == token_contract, "all records of a batch must have the same token contract");
+         eosio::check( items[i].quantity == trx.quantity, "item quantity == trx.quantity assert failed");
+         eosio::check( orig_froms[i] == trx.orig_from, "orig_from == trx.orig_from assert failed");
+
+         auto orig_info = get_memo_info( trx.orig_memo );
+         eosio::check( orig_info.peerchain == peerchain_name, "all records of a batch must have the same peer chain");
+         eosio::check( items[i].receiver == orig_info.receiver && items[i].notes == orig_info.notes, "item does not match user's original memo");
+
+         total += trx.quantity;
+         _proxytrxs.erase( trx );
+      }
+
+      transfer_action_type action_data{ _self, _gstate.ibc_token_account, total, proxy_batch_memo };
+      send_inline( action( permission_level{ _self, "active"_n }, token_contract, "transfer"_n, action_data ) );
+   }
+
    void proxy::mvtotrash( transaction_id_type orig_trx_id ){
 
       auto idx = _proxytrxs.get_index<"trxid"_n>();
-      const auto& trx_p = idx.find(fixed_bytes<32>(orig_trx_id));
+      const auto& trx_p = find_by_trx_id( idx, orig_trx_id, []( const auto& r ){ return r.orig_trx_id; } );
       eosio::check( trx_p != idx.end(), "transaction not found in table proxytrx.");
 
       auto duration = 3600*2*12; // half a day
       eosio::check( get_block_time_slot() - trx_p->block_time_slot > duration, "you can't move this proxy transaction to trash within half a day");
 
       auto idx2 = _proxytrxs2.get_index<"trxid"_n>();
-      const auto& trx_p2 = idx2.find(fixed_bytes<32>(orig_trx_id));
+      const auto& trx_p2 = find_by_trx_id( idx2, orig_trx_id, []( const auto& r ){ return r.orig_trx_id; } );
       eosio::check( trx_p2 == idx2.end(), "transaction already exist in table proxytrx2");
 
       _proxytrxs2.emplace( _self, [&]( auto& r ){ r = *trx_p; });
       _proxytrxs.erase( *trx_p );
    }
 
+   /**
+    * ids of table proxytrxs2 are copied from table proxytrxs and do not follow the creation order of the records,
+    * so records within trash_ttl are skipped, every record visited counts against max_rows.
+    * a log account must be set, because the full records are only kept in event evtrash.
+    */
+   void proxy::compacttrash( uint32_t max_rows ){
+      eosio::check( max_rows > 0, "max_rows must be greater than zero");
+      eosio::check( _events_st.log_account != name(), "log account not set, the compacted records are only kept in the event stream");
+
+      auto slot = get_block_time_slot();
+      auto itr = _proxytrxs2.begin();
+      for ( uint32_t count = 0; itr != _proxytrxs2.end() && count < max_rows; ++count ){
+         if ( slot - itr->block_time_slot <= trash_ttl ){
+            ++itr;
+            continue;
+         }
+
+         emit_event( "evtrash"_n, itr->id, itr->orig_trx_id, itr->block_time_slot, itr->token_contract, itr->orig_from, itr->quantity, itr->orig_memo );
+         _proxyarch.emplace( _self, [&]( auto& r ){
+            r.id                 = _proxyarch.available_primary_key();
+            r.trash_id           = itr->id;
+            r.orig_trx_id_prefix = trx_id_prefix( itr->orig_trx_id );
+            r.token_contract     = itr->token_contract;
+            r.quantity           = itr->quantity;
+            r.memo_hash          = ibc_sha256( itr->orig_memo.data(), itr->orig_memo.size() );
+         });
+         itr = _proxytrxs2.erase( itr );
+      }
+   }
+
+   void proxy::syncwhitelist( name token_contract ){
+      eosio::check( _gstate.ibc_token_account != name(), "ibc_token_account not set");
+
+      bool registered = token::token_contract_registered_in_accepts( _gstate.ibc_token_account, token_contract );
+      auto itr = _whitelist.find( token_contract.value );
+      if ( registered && itr == _whitelist.end() ){
+         _whitelist.emplace( _self, [&]( auto& r ){ r.token_contract = token_contract; });
+      } else if ( ! registered && itr != _whitelist.end() ){
+         _whitelist.erase( itr );
+      }
+   }
+
+   void proxy::setevents( name log_account ){
+      require_auth( _self );
+      _events_st.log_account = log_account;
+   }
+
+   void proxy::evtrash( uint64_t id, const transaction_id_type& orig_trx_id, uint64_t block_time_slot, name token_contract,
+                        name orig_from, const asset& quantity, const string& orig_memo ){
+      require_auth( _self );
+      if ( _events_st.log_account != name() ){ require_recipient( _events_st.log_account ); }
+   }
+
 } /// namespace eosio
 
 extern "C" {
    void apply( uint64_t receiver, uint64_t code, uint64_t action ) {
       if( code == receiver ) {
          switch( action ) {
-            EOSIO_DISPATCH_HELPER( eosio::proxy, (setglobal)(transfer)(mvtotrash))
+            EOSIO_DISPATCH_HELPER( eosio::proxy, (setglobal)(transfer)(forwardbatch)(mvtotrash)(compacttrash)(setevents)(syncwhitelist)(evtrash))
          }
          return;
       }
@@ -5,8 +5,10 @@
 #pragma once
 
 #include <eosiolib/core/eosio/asset.hpp>
+#include <eosiolib/core/eosio/binary_extension.hpp>
 #include <eosiolib/contracts/eosio/eosio.hpp>
 #include <eosiolib/contracts/eosio/singleton.hpp>
+#include <ibc.chain/log.hpp>
 #include <ibc.token/types.hpp>
 #include <ibc.proxy/ibc.proxy.hpp>
 
@@ -49,8 +51,95 @@ namespace eosio {
                         (orig_trx_block_id_merkle_path)(anchor_block_num)(to)(quantity)(memo)(relay) )
    };
 
+   /**
+    * cashfwd of a hub chain is a cash to the hub account followed by its forward transfer in the same action,
+    * the cash part is read as cash_action_type, and the forward part as the original transfer by the dest chain.
+    */
+   struct cashfwd_action_type : public cash_action_type {
+      transfer_action_type                   forward;
+
+      EOSLIB_SERIALIZE_DERIVED( cashfwd_action_type, cash_action_type, (forward) )
+   };
+
+   /**
+    * ibc bundles
+    * a bundle carries many transfers of one token to one peer chain in a single original transaction,
+    * so the peer chain verifies one receipt merkle proof and executes one cashbundle for all of them.
+    */
+   const static uint32_t max_bundle_items = 50;
+
+   struct bundle_item {
+      name    receiver;   // receiver on peer chain
+      asset   quantity;
+      string  notes;
+
+      EOSLIB_SERIALIZE( bundle_item, (receiver)(quantity)(notes) )
+   };
+
+   struct bundle_action_type {
+      name                       from;
+      name                       peerchain_name;
+      std::vector<bundle_item>   items;
+
+      EOSLIB_SERIALIZE( bundle_action_type, (from)(peerchain_name)(items) )
+   };
+
+   /**
+    * forwardbatch of ibc.proxy forwards many proxy records of one token to one peer chain in one transaction,
+    * its action data starts with a bundle whose from is the proxy account, so the peer chain cashes it by cashbundle.
+    * the proxy transfers the total to this contract with memo proxy_batch_memo.
+    */
+   static const string proxy_batch_memo = "forwardbatch";
+
+   struct forwardbatch_action_type : public bundle_action_type {
+      std::vector<uint64_t>   ids;          // ids of the records in table proxytrxs of ibc.proxy
+      std::vector<name>       orig_froms;   // original senders of the items, refunded by rollback
+
+      EOSLIB_SERIALIZE_DERIVED( forwardbatch_action_type, bundle_action_type, (ids)(orig_froms) )
+   };
+
+   struct cashbundle_action_type {
+      uint64_t                               seq_num;
+      name                                   from_chain;
+      transaction_id_type                    orig_trx_id;
+      std::vector<char>                      orig_trx_packed_trx_receipt;
+      std::vector<checksum256>               orig_trx_merkle_path;
+      uint32_t                               orig_trx_block_num;
+      std::vector<char>                      orig_trx_block_header_data;
+      std::vector<checksum256>               orig_trx_block_id_merkle_path;
+      uint32_t                               anchor_block_num;
+      name                                   relay;
+
+      EOSLIB_SERIALIZE( cashbundle_action_type, (seq_num)(from_chain)(orig_trx_id)(orig_trx_packed_trx_receipt)
+                        (orig_trx_merkle_path)(orig_trx_block_num)(orig_trx_block_header_data)
+                        (orig_trx_block_id_merkle_path)(anchor_block_num)(relay) )
+   };
+
    const static uint32_t default_max_trxs_per_minute_per_token = 100;
 
+   /**
+    * admission control of original transactions
+    * the allowed original transactions per block of a peer chain scale with the backlog of its table origtrxs:
+    * admission_boost_factor times max_original_trxs_per_block when the table is empty, down to one when it's nearly full,
+    * and none when it holds max_origtrxs_table_records records; no more than max_original_trxs_per_block
+    * when the oldest unconfirmed original transaction is older than admission_max_backlog_age block time slots.
+    */
+   const static uint32_t admission_boost_factor = 4;
+   const static uint32_t admission_max_backlog_age = 120;   // one minute
+
+   /**
+    * ibc lanes
+    * a lane is an independent cash/cashconfirm sequence channel between two chains, lane 0 is the default lane.
+    * the lane number is stored in the high bits of the cashblks table key, above the original transaction's block number.
+    */
+   const static uint32_t max_lanes_per_peerchain = 256;
+   const static uint32_t lane_key_shift = 48;
+   const static uint64_t lane_seq_mask = ( uint64_t(1) << lane_key_shift ) - 1;
+
+   inline uint64_t lane_key( uint32_t lane, uint64_t seq_num ){
+      return ( uint64_t(lane) << lane_key_shift ) | ( seq_num & lane_seq_mask );
+   }
+
    class [[eosio::contract("ibc.token")]] token : public contract {
       public:
       token( name s, name code, datastream<const char*> ds );
@@ -68,6 +157,10 @@ namespace eosio {
       [[eosio::action]]
       void setproxy( name proxy );
 
+      // empty log_account turns the event notifications off
+      [[eosio::action]]
+      void setevents( name log_account );
+
       [[eosio::action]]
       void setprchproxy( name peerchain_name, name proxy_account);
 
@@ -85,6 +178,16 @@ namespace eosio {
       [[eosio::action]]
       void setchainbool( name peerchain_name, string which, bool value );
 
+      // lanes must be configured identically on both chains, while the peer chain is inactive and has no in-flight transactions
+      [[eosio::action]]
+      void setlanes( name peerchain_name, uint32_t buckets );   // 0 means all tokens use the default lane 0
+
+      [[eosio::action]]
+      void setsymlane( name peerchain_name, symbol_code symcode, uint32_t lane );
+
+      [[eosio::action]]
+      void delsymlane( name peerchain_name, symbol_code symcode );
+
       [[eosio::action]]
       void regacpttoken( name        original_contract,
                          asset       max_accept,
@@ -183,6 +286,10 @@ namespace eosio {
                      asset   quantity,
                      string  memo );
 
+      // only supports tokens whose balances are kept in this contract, must be the only action of its transaction
+      [[eosio::action]]
+      void bundletransfer( name from, name peerchain_name, const std::vector<bundle_item>& items );
+
       // called by ibc plugin
       [[eosio::action]]
       void cash( const uint64_t&                        seq_num,
@@ -199,6 +306,19 @@ namespace eosio {
                  const string&                          memo,
                  const name&                            relay );
 
+      // called by ibc plugin, cash all transfers of a bundletransfer transaction
+      [[eosio::action]]
+      void cashbundle( const uint64_t&                        seq_num,
+                       const name&                            from_chain,
+                       const transaction_id_type&             orig_trx_id,
+                       const std::vector<char>&               orig_trx_packed_trx_receipt,
+                       const std::vector<checksum256>&        orig_trx_merkle_path,
+                       const uint32_t&                        orig_trx_block_num,
+                       const std::vector<char>&               orig_trx_block_header,
+                       const std::vector<checksum256>&        orig_trx_block_id_merkle_path,
+                       const uint32_t&                        anchor_block_num,
+                       const name&                            relay );
+
       // called by ibc plugin
       [[eosio::action]]
       void cashconfirm( const name&                            from_chain,
@@ -219,6 +339,32 @@ namespace eosio {
       [[eosio::action]]
       void rmunablerb( name peerchain_name, const transaction_id_type trx_id, name relay );   // force to remove unrollbackable transaction
 
+      // inline action, notification only
+      [[eosio::action]] /// used to support blockchain browser display peg tokens issued to the receiver by cash and cashbundle
+      void cashnotify( name from, name to, asset quantity, string memo );
+
+      // inline actions, notification only, the log account set by setevents receives them, used by trace based relays
+      [[eosio::action]]
+      void evorigtrx( name peerchain_name, uint64_t id, const transaction_id_type& trx_id, const asset& quantity );
+
+      [[eosio::action]]
+      void evcash( name peerchain_name, uint32_t lane, uint64_t seq_num, const transaction_id_type& orig_trx_id );
+
+      [[eosio::action]]
+      void evconfirm( name peerchain_name, uint32_t lane, uint64_t seq_num, const transaction_id_type& orig_trx_id );
+
+      [[eosio::action]]
+      void evrollback( name peerchain_name, const transaction_id_type& trx_id, const asset& refund );
+
+      // can be called by anyone periodically, refreshes table stat of the peg tokens whose supply changed,
+      // visiting at most max_rows rows of table stats from from_symcode on
+      [[eosio::action]]
+      void syncstats( symbol_code from_symcode, uint32_t max_rows );
+
+      // called by relays on their own schedule, pays out the service fees accrued by cash and cashbundle
+      [[eosio::action]]
+      void claimfees( name relay, const symbol_code& symcode );
+
       // this action maybe needed when repairing the ibc system manually
       [[eosio::action]]
       void fcrollback( name peerchain_name, const std::vector<transaction_id_type> trxs );   // force rollback
@@ -252,6 +398,10 @@ namespace eosio {
       [[eosio::action]]
       void rbkunrbktrx( const transaction_id_type trx_id );
 
+      // move records of the legacy cashtrxs table into cashblks table, cash of this peerchain is not allowed until finished
+      [[eosio::action]]
+      void mvcashtrxs( name peerchain_name, uint32_t max_rows );
+
 #ifdef HUB
       [[eosio::action]]
       void hubinit( name hub_account );
@@ -262,6 +412,36 @@ namespace eosio {
 
       [[eosio::action]]
       void rbkdiehubtrx( const transaction_id_type& hub_trx_id );
+
+      // called by ibc plugin, cash to the hub account and forward it to the dest chain in one step,
+      // forward is the transfer a worker would push after cash: hub_account -> _self with 'orig_trx_id=' of this cash in memo
+      [[eosio::action]]
+      void cashfwd( const uint64_t&                        seq_num,
+                    const name&                            from_chain,
+                    const transaction_id_type&             orig_trx_id,
+                    const std::vector<char>&               orig_trx_packed_trx_receipt,
+                    const std::vector<checksum256>&        orig_trx_merkle_path,
+                    const uint32_t&                        orig_trx_block_num,
+                    const std::vector<char>&               orig_trx_block_header,
+                    const std::vector<checksum256>&        orig_trx_block_id_merkle_path,
+                    const uint32_t&                        anchor_block_num,
+                    const name&                            to,
+                    const asset&                           quantity,
+                    const string&                          memo,
+                    const name&                            relay,
+                    const transfer_action_type&            forward );
+
+      // inline action, notification only, the user defined memo of a hub trx, table hubtrxs keeps only its hash
+      [[eosio::action]]
+      void evhubtrx( name to_chain, uint64_t id, const transaction_id_type& orig_trx_id, const checksum256& memo_hash, const string& memo );
+
+      // 0 means the default value defined by max_hub_unfinished_trxs
+      [[eosio::action]]
+      void sethubqueue( name to_chain, uint64_t max_unfinished_trxs );
+
+      // pay out at most max_rows hub fee balances accrued in table hubfees, can be called by any account
+      [[eosio::action]]
+      void settlehub( uint32_t max_rows );
 #endif
       static asset get_supply( name token_contract_account, symbol_code sym_code )
       {
@@ -297,6 +477,11 @@ namespace eosio {
          EOSLIB_SERIALIZE( proxy_struct, (proxy))
       };
 
+      struct [[eosio::table("events")]] events_struct {
+         name              log_account;   // receives the ev* notifications, empty means no events are sent
+         EOSLIB_SERIALIZE( events_struct, (log_account))
+      };
+
       // code,scope (_self,_self)
       struct [[eosio::table]] currency_accept {
          name        original_contract;
@@ -319,7 +504,7 @@ namespace eosio {
          uint64_t    total_cash_times;
          bool        active;
 
-         struct currency_accept_mutables {
+         struct currency_accept_mutables {   // deprecated, fixed window counters replaced by limits
             uint32_t    minute_trx_start;
             uint32_t    minute_trxs;
             uint32_t    daily_tf_start;
@@ -328,10 +513,16 @@ namespace eosio {
             asset       daily_wd_sum;
          } mutables;
 
+         struct currency_accept_limits {
+            token_bucket   trxs;       // max_tfs_per_minute, in seconds
+            token_bucket   daily_tf;   // max_daily_transfer, in seconds
+         };
+         binary_extension<currency_accept_limits> limits;
+
          uint64_t  primary_key()const { return accept.symbol.code().raw(); } /// by token symbol
          uint64_t  by_original_contract()const { return original_contract.value; }
       };
-      typedef eosio::multi_index< "accepts"_n, currency_accept,
+      typedef ibc_multi_index< "accepts"_n, currency_accept,
             indexed_by<"origcontract"_n, const_mem_fun<currency_accept, uint64_t, &currency_accept::by_original_contract> >
       > accepts_table;
 
@@ -349,6 +540,14 @@ namespace eosio {
       admin_struct                                    _admin_st;
       eosio::singleton< "proxy"_n, proxy_struct >     _proxy_sg;
       proxy_struct                                    _proxy_st;
+      eosio::singleton< "events"_n, events_struct >   _events_sg;
+      events_struct                                   _events_st;
+
+      template<typename... Args>
+      void emit_event( name event, Args&&... args ){
+         if ( _events_st.log_account == name() ){ return; }
+         send_inline( action( permission_level{ _self, "active"_n }, _self, event, std::make_tuple( std::forward<Args>(args)... ) ) );
+      }
 
       // code,scope (_self,_self)
       struct [[eosio::table("freeaccount")]] peer_chain_free_account {
@@ -358,7 +557,7 @@ namespace eosio {
          uint64_t primary_key()const { return peerchain_name.value; }
          EOSLIB_SERIALIZE( peer_chain_free_account, (peerchain_name)(peerchain_account))
       };
-      eosio::multi_index< "freeaccount"_n, peer_chain_free_account > _freeaccount;
+      ibc_multi_index< "freeaccount"_n, peer_chain_free_account > _freeaccount;
 
       // code,scope (_self,_self)
       struct [[eosio::table("peerchains")]] peer_chain_state {
@@ -377,7 +576,7 @@ namespace eosio {
                            (thischain_ibc_chain_contract)(thischain_free_account)(max_original_trxs_per_block)
                            (max_origtrxs_table_records)(cache_cashtrxs_table_records)(active))
       };
-      eosio::multi_index< "peerchains"_n, peer_chain_state > _peerchains;
+      ibc_multi_index< "peerchains"_n, peer_chain_state > _peerchains;
 
       // code,scope (_self,_self)
       struct [[eosio::table("peerchains2")]] peer_chain_state2 {
@@ -387,7 +586,7 @@ namespace eosio {
          uint64_t primary_key()const { return peerchain_name.value; }
          EOSLIB_SERIALIZE( peer_chain_state2, (peerchain_name)(proxy_account))
       };
-      eosio::multi_index< "peerchains2"_n, peer_chain_state2 > _peerchains2;
+      ibc_multi_index< "peerchains2"_n, peer_chain_state2 > _peerchains2;
 
 
       // code,scope(_self,peerchain_name.value)
@@ -396,7 +595,7 @@ namespace eosio {
 
          uint64_t primary_key()const { return balance.symbol.code().raw(); }
       };
-      typedef eosio::multi_index< "chainassets"_n, peer_chain_asset > chainassets_table;
+      typedef ibc_multi_index< "chainassets"_n, peer_chain_asset > chainassets_table;
 
 
       // code,scope (_self,_self)
@@ -406,15 +605,74 @@ namespace eosio {
          name        peerchain_name;
          uint64_t    cash_seq_num = 0;    // set by seq_num in cash action from cashconfirm action, and must be increase one by one, and start from one
          uint32_t    last_confirmed_orig_trx_block_time_slot = 0; // used to determine which failed original transactions should be rolled back
-         uint32_t    current_block_time_slot = 0;
-         uint32_t    current_block_trxs = 0;
+         uint32_t    current_block_time_slot = 0; // deprecated, replaced by block_trxs
+         uint32_t    current_block_trxs = 0;      // deprecated, replaced by block_trxs
          uint64_t    origtrxs_tb_next_id = 1; // used to retain an incremental id for table origtrxs
+         binary_extension<token_bucket> block_trxs; // max_original_trxs_per_block, in block time slots
+         binary_extension<uint64_t> pending_origtrxs; // records of table origtrxs, rows written by v4 start from 0
+         binary_extension<uint64_t> oldest_origtrx_id;   // id of the first record of table origtrxs, 0 if empty
+         binary_extension<uint32_t> oldest_origtrx_slot; // block_time_slot of the first record of table origtrxs
+
+         // an absent extension is serialized as nothing, so writing a later one requires all earlier ones present,
+         // called by every write of the extensions
+         void fill_extensions(){
+            block_trxs.emplace( block_trxs.value_or() );
+            pending_origtrxs.emplace( pending_origtrxs.value_or( 0 ) );
+            oldest_origtrx_id.emplace( oldest_origtrx_id.value_or( 0 ) );
+            oldest_origtrx_slot.emplace( oldest_origtrx_slot.value_or( 0 ) );
+         }
 
          uint64_t primary_key()const { return peerchain_name.value; }
          EOSLIB_SERIALIZE( peer_chain_mutable, (peerchain_name)(cash_seq_num)(last_confirmed_orig_trx_block_time_slot)
-                           (current_block_time_slot)(current_block_trxs)(origtrxs_tb_next_id) )
+                           (current_block_time_slot)(current_block_trxs)(origtrxs_tb_next_id)(block_trxs)(pending_origtrxs)
+                           (oldest_origtrx_id)(oldest_origtrx_slot) )
+      };
+      ibc_multi_index< "peerchainm"_n, peer_chain_mutable > _peerchainm;
+
+      // code,scope (_self,_self)
+      struct [[eosio::table("lanecfg")]] peer_chain_lanes {
+         name        peerchain_name;
+         uint32_t    buckets = 0;   // when not 0, tokens without a symlanes record use lane (symbol_code % buckets)
+         uint64_t    orig_trx_block_num_floor = 0;   // highest orig_trx_block_num cashed before the last lane change, used to prevent replay attacks
+
+         uint64_t primary_key()const { return peerchain_name.value; }
+         EOSLIB_SERIALIZE( peer_chain_lanes, (peerchain_name)(buckets)(orig_trx_block_num_floor) )
+      };
+      ibc_multi_index< "lanecfg"_n, peer_chain_lanes > _lanecfg;
+
+      // code,scope(_self,peerchain_name.value)
+      struct [[eosio::table("symlanes")]] symbol_lane {
+         symbol_code sym_code;
+         uint32_t    lane;
+
+         uint64_t primary_key()const { return sym_code.raw(); }
+         EOSLIB_SERIALIZE( symbol_lane, (sym_code)(lane) )
+      };
+      typedef ibc_multi_index< "symlanes"_n, symbol_lane > symlanes_table;
+
+      // lane 0 uses the members of peer_chain_mutable, other lanes use this table
+      // code,scope(_self,peerchain_name.value)
+      struct [[eosio::table("chainlanes")]] peer_chain_lane_mutable {
+         uint64_t    lane;
+         uint64_t    cash_seq_num = 0;
+         uint32_t    last_confirmed_orig_trx_block_time_slot = 0;
+
+         uint64_t primary_key()const { return lane; }
+         EOSLIB_SERIALIZE( peer_chain_lane_mutable, (lane)(cash_seq_num)(last_confirmed_orig_trx_block_time_slot) )
       };
-      eosio::multi_index< "peerchainm"_n, peer_chain_mutable > _peerchainm;
+      typedef ibc_multi_index< "chainlanes"_n, peer_chain_lane_mutable > chainlanes_table;
+
+      struct lane_info {
+         uint32_t    lane = 0;
+         uint64_t    orig_trx_block_num_floor = 0;
+      };
+      lane_info get_lane( name peerchain_name, symbol_code sym_code );
+      uint64_t get_lane_cash_seq_num( name peerchain_name, uint32_t lane );
+      void increase_lane_cash_seq_num( name peerchain_name, uint32_t lane );
+      uint32_t get_lane_last_confirmed_slot( name peerchain_name, uint32_t lane );
+      void set_lane_last_confirmed_slot( name peerchain_name, uint32_t lane, uint32_t slot );
+      void check_lanes_changeable( name peerchain_name );
+      void update_lanes_floor( name peerchain_name );
 
 
       accepts_table     _accepts;
@@ -444,7 +702,7 @@ namespace eosio {
          bool        active;
          bool        hub_enable = false;
 
-         struct currency_stats_mutables {
+         struct currency_stats_mutables {   // deprecated, fixed window counters replaced by limits
             uint32_t    minute_trx_start;
             uint32_t    minute_trxs;
             uint32_t    daily_isu_start;
@@ -453,9 +711,17 @@ namespace eosio {
             asset       daily_wd_sum;
          } mutables;
 
+         binary_extension<bool> stats2_dirty;  // supply changed by ibc transfers since table stat was last refreshed by syncstats
+
+         struct currency_stats_limits {
+            token_bucket   wds;        // max_wds_per_minute, in seconds
+            token_bucket   daily_wd;   // max_daily_withdraw, in seconds
+         };
+         binary_extension<currency_stats_limits> limits;
+
          uint64_t primary_key()const { return supply.symbol.code().raw(); }
       };
-      typedef eosio::multi_index< "stats"_n, currency_stats > stats;
+      typedef ibc_multi_index< "stats"_n, currency_stats > stats;
       stats _stats;
       const currency_stats& get_currency_stats( symbol_code symcode );
 
@@ -464,7 +730,19 @@ namespace eosio {
 
          uint64_t primary_key()const { return balance.symbol.code().raw(); }
       };
-      typedef eosio::multi_index< "accounts"_n, account > accounts;
+      typedef ibc_multi_index< "accounts"_n, account > accounts;
+
+      // service fees earned by relays in cash and cashbundle, the tokens are held by _self until claimed
+      // code,scope (_self,relay)
+      struct [[eosio::table]] relay_fee {
+         asset    balance;
+         name     token_contract;   // the contract which transfers the token on this chain
+
+         uint64_t primary_key()const { return balance.symbol.code().raw(); }
+      };
+      typedef ibc_multi_index< "relayfees"_n, relay_fee > relayfees_table;
+
+      void accrue_relay_fee( name relay, const asset& fee, name token_contract );
 
       // table stat is just used for command 'cleos get currency stats ...' compatibility
       // code,scope (_self,sym_code)
@@ -475,7 +753,7 @@ namespace eosio {
 
          uint64_t primary_key()const { return supply.symbol.code().raw(); }
       };
-      typedef eosio::multi_index< "stat"_n, currency_stats2 > stats2;
+      typedef ibc_multi_index< "stat"_n, currency_stats2 > stats2;
 
       void update_stats2( symbol_code sym_code );
 
@@ -490,54 +768,77 @@ namespace eosio {
 
          uint64_t primary_key()const { return id; }
          uint64_t by_time_slot()const { return block_time_slot; }
-         fixed_bytes<32> by_trx_id()const { return fixed_bytes<32>(trx_id); }
+         uint64_t by_trx_id()const { return trx_id_prefix(trx_id); }
       };
-      typedef eosio::multi_index< "origtrxs"_n, original_trx_info,
-         indexed_by<"tslot"_n, const_mem_fun<original_trx_info, uint64_t,        &original_trx_info::by_time_slot> >,  // used by ibc plugin
-         indexed_by<"trxid"_n, const_mem_fun<original_trx_info, fixed_bytes<32>, &original_trx_info::by_trx_id> >
+      typedef ibc_multi_index< "origtrxs"_n, original_trx_info,
+         indexed_by<"tslot"_n, const_mem_fun<original_trx_info, uint64_t, &original_trx_info::by_time_slot> >,  // used by ibc plugin
+         indexed_by<"trxid"_n, const_mem_fun<original_trx_info, uint64_t, &original_trx_info::by_trx_id> >     // use find_by_trx_id()
       >  origtrxs_table;
 
       void origtrxs_emplace( name peerchain_name, transfer_action_info action, transaction_id_type trx_id );
       void rollback_trx( name peerchain_name, transaction_id_type trx_id );
       transfer_action_info get_orignal_action_by_trx_id( name peerchain_name, transaction_id_type trx_id );
-      void erase_record_in_origtrxs_tb_by_trx_id_for_confirmed( name peerchain_name, transaction_id_type trx_id );
+      asset erase_record_in_origtrxs_tb_by_trx_id_for_confirmed( name peerchain_name, transaction_id_type trx_id );   // returns the total quantity of erased records
 
 
       /**
        * Note:
        * "orig_trx_block_num" is a very important parameter, in order to prevent replay attacks:
-       * first, new record's block_num must not less then the highest block_num in the table,
+       * first, new record's block_num must not less then the highest block_num in the lane,
        *        (so, the ibc plugin is required to take a mechanism to ensure that the original transaction is sent to this contract in the order in which it occured)
        * second, when delete old records, it is important to ensure that the records of heighest two block number must retain.
        * The above two features must be satisfied at the same time. Breaking any one of them will lead to serious replay attacks.
        * set cache_cashtrxs_table_records parameter, when above feature satified, this parameter will take effect
+       *
+       * cashed original transactions are grouped by their block number, an original transaction can only be proven in
+       * its own block, so the duplicate check only needs to look at the row of that block.
        */
+      struct cash_trx_entry {
+         uint64_t              seq_num;          // seq_num in cash action, must be increase one by one in a lane, and start from 1
+         uint32_t              block_time_slot;
+         checksum256           trx_id;           // cash transaction id, used by ibc plugin to call cashconfirm
+         checksum256           orig_trx_id;
+
+         EOSLIB_SERIALIZE( cash_trx_entry, (seq_num)(block_time_slot)(trx_id)(orig_trx_id) )
+      };
+
+      // code,scope(_self,peerchain_name.value)
+      struct [[eosio::table]] cash_block_info {
+         uint64_t                      key;     // lane_key( lane, orig_trx_block_num )
+         std::vector<cash_trx_entry>   trxs;    // in seq_num order
+
+         uint64_t primary_key()const { return key; }
+         uint64_t orig_trx_block_num()const { return key & lane_seq_mask; }
+      };
+      typedef ibc_multi_index< "cashblks"_n, cash_block_info > cashblks_table;
+
+      void cashblks_emplace( name peerchain_name, uint32_t lane, uint32_t orig_trx_block_num, const cash_trx_entry& entry );
+      void trim_cashblks_table_or_not( name peerchain_name, uint32_t lane );
+      uint64_t get_cashblks_tb_max_seq_num( name peerchain_name, uint32_t lane );
+      uint64_t get_cashblks_tb_max_orig_trx_block_num( name peerchain_name, uint32_t lane );
+      bool is_orig_trx_id_exist_in_cashblks_tb( name peerchain_name, uint32_t lane, uint32_t orig_trx_block_num, const transaction_id_type& orig_trx_id );
+
+      // legacy table replaced by cashblks, only kept for mvcashtrxs and forceinit
       // code,scope(_self,peerchain_name.value)
       struct [[eosio::table]] cash_trx_info {
-         uint64_t              seq_num; // set by seq_num in cash action, and must be increase one by one, and start from 1
+         uint64_t              seq_num;
          uint64_t              block_time_slot;
          checksum256      trx_id;
-         transfer_action_type  action;                // redundant, facilitate indexing and checking
-         checksum256      orig_trx_id;           // redundant, facilitate indexing and checking
-         uint64_t              orig_trx_block_num;    // very important!
+         transfer_action_type  action;
+         checksum256      orig_trx_id;
+         uint64_t              orig_trx_block_num;
 
          uint64_t primary_key()const { return seq_num; }
          uint64_t by_time_slot()const { return block_time_slot; }
          fixed_bytes<32> by_orig_trx_id()const { return fixed_bytes<32>(orig_trx_id); }
          uint64_t by_orig_trx_block_num()const { return orig_trx_block_num; }
       };
-      typedef eosio::multi_index< "cashtrxs"_n, cash_trx_info,
-         indexed_by<"tslot"_n,    const_mem_fun<cash_trx_info, uint64_t,        &cash_trx_info::by_time_slot> >,  // used by ibc plugin
+      typedef ibc_multi_index< "cashtrxs"_n, cash_trx_info,
+         indexed_by<"tslot"_n,    const_mem_fun<cash_trx_info, uint64_t,        &cash_trx_info::by_time_slot> >,
          indexed_by<"trxid"_n,    const_mem_fun<cash_trx_info, fixed_bytes<32>, &cash_trx_info::by_orig_trx_id> >,
          indexed_by<"blocknum"_n, const_mem_fun<cash_trx_info, uint64_t,        &cash_trx_info::by_orig_trx_block_num> >
       > cashtrxs_table;
 
-      void trim_cashtrxs_table_or_not( name peerchain_name );
-      uint64_t get_cashtrxs_tb_max_seq_num( name peerchain_name );
-      uint64_t get_cashtrxs_tb_min_orig_trx_block_num( name peerchain_name );
-      uint64_t get_cashtrxs_tb_max_orig_trx_block_num( name peerchain_name );
-      bool is_orig_trx_id_exist_in_cashtrxs_tb( name peerchain_name, transaction_id_type orig_trx_id );
-
       // use to record removed unrollbackable transactions
       // code,scope(_self,peerchain_name.value)
       struct [[eosio::table]] deleted_unrollbackable_trx_info {
@@ -546,7 +847,7 @@ namespace eosio {
 
          uint64_t primary_key()const { return id; }
       };
-      typedef eosio::multi_index< "rmdunrbs"_n, deleted_unrollbackable_trx_info>  rmdunrbs_table;
+      typedef ibc_multi_index< "rmdunrbs"_n, deleted_unrollbackable_trx_info>  rmdunrbs_table;
 
       // use to record removed unrollbackable transactions
       // code,scope(_self,_self.value)
@@ -557,13 +858,38 @@ namespace eosio {
          transfer_action_info    action; // used when execute rollback
 
          uint64_t primary_key()const { return id; }
-         fixed_bytes<32> by_trx_id()const { return fixed_bytes<32>(trx_id); }
+         uint64_t by_trx_id()const { return trx_id_prefix(trx_id); }
       };
-      typedef eosio::multi_index< "rmdunrbs2"_n, deleted_unrollbackable_trx_info2,
-          indexed_by<"trxid"_n, const_mem_fun<deleted_unrollbackable_trx_info2, fixed_bytes<32>, &deleted_unrollbackable_trx_info2::by_trx_id> >
+      typedef ibc_multi_index< "rmdunrbs2"_n, deleted_unrollbackable_trx_info2,
+          indexed_by<"trxid"_n, const_mem_fun<deleted_unrollbackable_trx_info2, uint64_t, &deleted_unrollbackable_trx_info2::by_trx_id> >
       >  rmdunrbs_table2;
 
-      void withdraw( name from, name peerchain_name, name peerchain_receiver, asset quantity, string memo );
+      checksum256 get_outermost_transfer_trx_id( name from, name to, const asset& quantity, const string& memo );
+      void ibc_transfer_notify( name token_contract, name from, const asset& quantity, const memo_info_type& info, const checksum256& trx_id );
+      void proxy_batch_notify( name token_contract, const asset& quantity );
+      void withdraw( name from, const memo_info_type& info, asset quantity );
+      void ibc_transfer_accounting( name token_contract, name peerchain_name, const asset& quantity );
+      void ibc_withdraw_accounting( name peerchain_name, const asset& quantity );
+      void check_max_original_trxs_per_block( const peer_chain_state& pch, uint32_t new_trxs = 1 );
+      void update_origtrxs_summary( name peerchain_name, uint64_t erased );
+
+      void check_cash_replay( name from_chain, const lane_info& lane, uint64_t seq_num, const transaction_id_type& orig_trx_id, uint32_t orig_trx_block_num );
+      action get_orig_trx_action( const transaction_receipt& trx_receipt, const transaction_id_type& orig_trx_id );
+      void verify_orig_trx_inclusion( const peer_chain_state& pch, const digest_type& receipt_digest,
+                                      const std::vector<checksum256>& orig_trx_merkle_path,
+                                      uint32_t orig_trx_block_num,
+                                      const std::vector<char>& orig_trx_block_header_data,
+                                      const std::vector<checksum256>& orig_trx_block_id_merkle_path,
+                                      uint32_t anchor_block_num );
+      bundle_action_type get_bundle_from_action( const action& actn, const peer_chain_state& pch );
+      transfer_action_type get_transfer_from_action( const action& actn, name ibc_token_contract );
+
+      struct cash_payout_info {
+         asset    quantity;         // quantity with this chain's symbol
+         asset    fee;              // service fee charged, sent to relay by the caller
+         name     token_contract;   // the contract which transfers the token on this chain
+      };
+      cash_payout_info cash_payout( const peer_chain_state& pch, name orig_account, name to, const asset& quantity, string notes, bool from_free_account );
       void sub_balance( name owner, asset value );
       void add_balance( name owner, asset value, name ram_payer );
       void verify_merkle_path( const std::vector<checksum256>& merkle_path, digest_type check );
@@ -578,50 +904,100 @@ namespace eosio {
          hub_globals(){}
          bool                 is_open = false;
          name                 hub_account;
-         uint64_t             unfinished_trxs = 0;
+         uint64_t             unfinished_trxs = 0;   // deprecated, counted per destination chain in table hubqueues
          EOSLIB_SERIALIZE( hub_globals, (is_open)(hub_account)(unfinished_trxs))
       };
       eosio::singleton< "hubgs"_n, hub_globals >   _hub_globals;
       hub_globals                                  _hubgs;
-      
+      bool                                         _hubgs_changed = false;   // the singleton is written back only when changed
+      bool                                         _hub_forwarding = false;  // transfer() is called by cashfwd
+
       // code,scope(_self,_self.value)
+      struct [[eosio::table]] hub_queue {
+         name                  to_chain;
+         uint64_t              next_id = 1;               // id sequence of table hubtrxs of this scope
+         uint64_t              unfinished_trxs = 0;
+         uint64_t              max_unfinished_trxs = 0;   // 0 means the default value defined by max_hub_unfinished_trxs
+
+         uint64_t primary_key()const { return to_chain.value; }
+         EOSLIB_SERIALIZE( hub_queue, (to_chain)(next_id)(unfinished_trxs)(max_unfinished_trxs) )
+      };
+      typedef ibc_multi_index< "hubqueues"_n, hub_queue > hubqueues_table;
+
+      enum hub_trx_state : uint8_t {
+         hub_trx_cashed      = 0,   // waiting for the transfer to the dest chain or back to the original chain
+         hub_trx_transferred = 1    // transferred, waiting for cashconfirm or rollback
+      };
+
+      // code,scope(_self,to_chain.value), fixed width fields only, the dest chain is the scope
       struct [[eosio::table]] hub_trx_info {
-         uint64_t              id; // set by seq_num in cash action
-         uint64_t              cash_time_slot;
+         uint64_t              id; // from the id sequence of the to_chain queue in table hubqueues
          name                  from_chain;
          name                  from_account;
-         asset                 from_quantity;
-         asset                 mini_to_quantity; /// minimum transfer amount
-         checksum256      orig_trx_id;
-         name                  to_chain;
          name                  to_account;
-         string                orig_pure_memo;
-         asset                 to_quantity;
          name                  fee_receiver;
-         checksum256      hub_trx_id;
-         uint64_t              hub_trx_time_slot;
-         uint8_t               forward_times;
-         uint8_t               backward_times;
+         symbol                sym;
+         int64_t               from_amount;
+         int64_t               mini_to_amount;   /// minimum transfer amount
+         int64_t               to_amount;
+         checksum256           orig_trx_id;
+         checksum256           hub_trx_id;
+         checksum256           memo_hash;        /// sha256 of the user defined memo, the text is in event evhubtrx
+         uint32_t              cash_time_slot;
+         uint32_t              hub_trx_time_slot;
+         uint32_t              status = 0;       /// forward_times | backward_times << 8 | state << 16
 
          uint64_t primary_key()const { return id; }
-         fixed_bytes<32> by_orig_trx_id()const { return fixed_bytes<32>(orig_trx_id.hash); }
-         fixed_bytes<32> by_hub_trx_id()const { return fixed_bytes<32>(hub_trx_id.hash); }
+         uint64_t by_orig_trx_id()const { return trx_id_prefix(orig_trx_id); }
+         uint64_t by_hub_trx_id()const { return trx_id_prefix(hub_trx_id); }
+
+         asset from_quantity()const { return asset{ from_amount, sym }; }
+         asset mini_to_quantity()const { return asset{ mini_to_amount, sym }; }
+         asset to_quantity()const { return asset{ to_amount, sym }; }
+
+         uint8_t forward_times()const { return status & 0xff; }
+         uint8_t backward_times()const { return (status >> 8) & 0xff; }
+         uint8_t state()const { return (status >> 16) & 0xff; }
+         void set_status( uint8_t forward_times, uint8_t backward_times, uint8_t state ){
+            status = uint32_t(forward_times) | uint32_t(backward_times) << 8 | uint32_t(state) << 16;
+         }
       };
-      typedef eosio::multi_index< "hubtrxs"_n, hub_trx_info,
-      indexed_by<"origtrxid"_n,   const_mem_fun<hub_trx_info, fixed_bytes<32>, &hub_trx_info::by_orig_trx_id> >,
-      indexed_by<"hubtrxid"_n,    const_mem_fun<hub_trx_info, fixed_bytes<32>, &hub_trx_info::by_hub_trx_id> >
+      typedef ibc_multi_index< "hubtrxs"_n, hub_trx_info,
+      indexed_by<"origtrxid"_n,   const_mem_fun<hub_trx_info, uint64_t, &hub_trx_info::by_orig_trx_id> >,
+      indexed_by<"hubtrxid"_n,    const_mem_fun<hub_trx_info, uint64_t, &hub_trx_info::by_hub_trx_id> >
       > hubtrxs_table;
 
+      // code,scope(_self,_self.value)
+      struct [[eosio::table]] hub_fee {
+         uint64_t    id;
+         name        receiver;
+         asset       balance;
+
+         uint64_t  primary_key()const { return id; }
+         uint128_t by_receiver_symbol()const { return hub_fee_key( receiver, balance.symbol.code() ); }
+      };
+      typedef ibc_multi_index< "hubfees"_n, hub_fee,
+      indexed_by<"receiversym"_n, const_mem_fun<hub_fee, uint128_t, &hub_fee::by_receiver_symbol> >
+      > hubfees_table;
+
+      static uint128_t hub_fee_key( name receiver, symbol_code symcode ){
+         return (uint128_t(receiver.value) << 64) | symcode.raw();
+      }
+
+      void accrue_hub_fee( name receiver, const asset& fee );
+
       void ibc_cash_to_hub( const uint64_t&                 cash_seq_num,
                             const name&                     from_chain,
                             const name&                     from_account,
                             const transaction_id_type&      orig_trx_id,
                             const asset&                    quantity,
-                            const string&                   memo,
+                            std::string_view                memo,
                             bool                            from_free_account);
-      void ibc_transfer_from_hub( const name& to, const asset& quantity, const string& memo );
-      void delete_by_hub_trx_id( const transaction_id_type& hub_trx_id );     // when successfully completed
-      void rollback_hub_trx( const transaction_id_type& hub_trx_id, asset quantity );   // when ibc transmit fails
+      void ibc_transfer_from_hub( const name& to, const asset& quantity, const memo_info_type& memo_info );
+      void delete_by_hub_trx_id( name peerchain_name, const transaction_id_type& hub_trx_id );     // when successfully completed
+      void check_hub_forward_confirmed( name peerchain_name, const transaction_id_type& hub_trx_id, const transfer_action_type& forward );
+      void rollback_hub_trx( name peerchain_name, const transaction_id_type& hub_trx_id, asset quantity );   // when ibc transmit fails
+      name get_hub_trx_scope( const transaction_id_type& trx_id, bool by_hub_trx_id, name hint_chain );
 #endif
 
       void check_admin_auth();
@@ -6,6 +6,7 @@
 
 #include <eosiolib/contracts/eosio/transaction.hpp>
 #include <ibc.chain/types.hpp>
+#include <string_view>
 
 namespace eosio {
 
@@ -27,7 +28,7 @@ namespace eosio {
 
       transaction_id_type id()const {
          checksum256 digest;
-         assert_sha256(packed_trx.data(), packed_trx.size(), digest);
+         ibc_assert_sha256(packed_trx.data(), packed_trx.size(), digest);
          return digest;
       }
 
@@ -58,4 +59,56 @@ namespace eosio {
       EOSLIB_SERIALIZE_DERIVED( transaction_receipt, transaction_receipt_header,(trx))
    };
 
+   /**
+    * compact token bucket rate limiter (16 bytes), allows a burst of up to `burst` units and refills
+    * `burst` units per `period` continuously, the time unit (seconds, block time slots ...) is chosen by the caller.
+    * limit parameters are not stored, they are read from the configuration of the row which owns the bucket.
+    */
+   struct token_bucket {
+      int64_t     available = 0;     // units left in the bucket
+      uint64_t    last_refill = 0;   // 0 means never used, the bucket starts full
+
+      /// refills the bucket up to now, then takes cost units from it, returns false if there are not enough units
+      bool consume( uint64_t now, int64_t burst, uint64_t period, int64_t cost ){
+         if ( last_refill == 0 || now < last_refill ){
+            available = burst;
+            last_refill = now;
+         } else if ( now > last_refill && burst > 0 ){
+            __int128 refill = __int128( now - last_refill ) * burst / period;
+            if ( available + refill >= burst ){
+               available = burst;
+               last_refill = now;
+            } else if ( refill > 0 ){
+               available += int64_t( refill );
+               last_refill += uint64_t( refill * period / burst );   // keep the fraction of a unit not refilled yet
+            }
+         }
+         if ( available > burst ){ available = burst; }   // the limit may have been lowered
+
+         if ( available < cost ){ return false; }
+         available -= cost;
+         return true;
+      }
+
+      EOSLIB_SERIALIZE( token_bucket, (available)(last_refill) )
+   };
+
+   /**
+    * result of parsing an ibc transfer memo in one pass, see get_memo_info() in utils.cpp
+    * all string_view members point into the parsed memo string, which must outlive this struct;
+    * the key=value members are empty when the key is not present in the memo.
+    * for a binary memo (v2) the key=value members hold the raw fixed-width field bytes instead of text,
+    * use memo_value_to_name() and memo_value_to_checksum256() to read them.
+    */
+   struct memo_info_type {
+      bool                 binary = false;
+      name                 receiver;
+      name                 peerchain;
+      std::string_view     notes;         // everything after '{receiver}@{chain}', including the key=value pairs
+      std::string_view     orig_trxid;    // appended by ibc.proxy
+      std::string_view     orig_from;     // appended by ibc.proxy
+      std::string_view     orig_trx_id;   // hub transfer
+      std::string_view     worker;        // hub transfer
+   };
+
 }
@@ -19,10 +19,12 @@ namespace eosio {
          _global_state( _self, _self.value ),
          _admin_sg(_self, _self.value),
          _proxy_sg(_self, _self.value),
+         _events_sg(_self, _self.value),
          _peerchains( _self, _self.value ),
          _peerchains2( _self, _self.value ),
          _freeaccount( _self, _self.value ),
          _peerchainm( _self, _self.value ),
+         _lanecfg( _self, _self.value ),
          _accepts( _self, _self.value ),
          _stats( _self, _self.value )
          #ifdef HUB
@@ -32,6 +34,7 @@ namespace eosio {
       _gstate = _global_state.exists() ? _global_state.get() : global_state{};
       _admin_st = _admin_sg.exists() ? _admin_sg.get() : admin_struct{};
       _proxy_st = _proxy_sg.exists() ? _proxy_sg.get() : proxy_struct{};
+      _events_st = _events_sg.exists() ? _events_sg.get() : events_struct{};
       #ifdef HUB
       _hubgs = _hub_globals.exists() ? _hub_globals.get() : hub_globals{};
       #endif
@@ -41,8 +44,12 @@ namespace eosio {
       _global_state.set( _gstate, _self );
       _admin_sg.set( _admin_st , _self );
       _proxy_sg.set( _proxy_st , _self );
+      _events_sg.set( _events_st , _self );
       #ifdef HUB
-      _hub_globals.set( _hubgs, _self );
+      if ( _hubgs_changed ){ _hub_globals.set( _hubgs, _self ); }
+      #endif
+      #ifdef IBC_INSTRUMENT
+      instrument::print_summary();
       #endif
    }
    
@@ -69,6 +76,12 @@ namespace eosio {
       }
    }
 
+   void token::setevents( name log_account ){
+      check_admin_auth();
+      eosio::check( log_account == name() || is_account(log_account), "log_account is not exist");
+      _events_st.log_account = log_account;
+   }
+
    void token::setprchproxy( name peerchain_name, name proxy_account){
       auto itr = _peerchains.find( peerchain_name.value );
       eosio::check( itr != _peerchains.end(), "peerchain has not registered");
@@ -114,6 +127,10 @@ namespace eosio {
       eosio::check( 500 <= max_origtrxs_table_records && max_origtrxs_table_records <= 2000 ,"max_origtrxs_table_records must in range [500,2000]");
       eosio::check( 1000 <= cache_cashtrxs_table_records && cache_cashtrxs_table_records <= 2000 ,"cache_cashtrxs_table_records must in range [1000,2000]");
 
+      // re-registration resets table peerchainm, including the origtrxs counters used by admission control
+      auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
+      eosio::check( _origtrxs.begin() == _origtrxs.end(), "table origtrxs of the peer chain must be empty, run forceinit first");
+
       auto itr = _peerchains.find( peerchain_name.value );
       if ( itr != _peerchains.end() ){ _peerchains.erase( itr );}
 
@@ -139,6 +156,7 @@ namespace eosio {
          r.current_block_time_slot  = 0;
          r.current_block_trxs       = 0;
          r.origtrxs_tb_next_id      = 1;
+         r.fill_extensions();
       });
    }
 
@@ -153,6 +171,52 @@ namespace eosio {
       eosio::check( false, "unkown config item" );
    }
 
+   void token::setlanes( name peerchain_name, uint32_t buckets ){
+      check_admin_auth();
+      check_lanes_changeable( peerchain_name );
+      eosio::check( buckets <= max_lanes_per_peerchain, "buckets must in range [0,256]");
+
+      auto ptr = _lanecfg.find( peerchain_name.value );
+      if ( ptr == _lanecfg.end() ){
+         _lanecfg.emplace( _self, [&]( auto& r ){
+            r.peerchain_name  = peerchain_name;
+            r.buckets         = buckets;
+         });
+      } else {
+         _lanecfg.modify( ptr, same_payer, [&]( auto& r ){ r.buckets = buckets; });
+      }
+      update_lanes_floor( peerchain_name );
+   }
+
+   void token::setsymlane( name peerchain_name, symbol_code symcode, uint32_t lane ){
+      check_admin_auth();
+      check_lanes_changeable( peerchain_name );
+      eosio::check( lane < max_lanes_per_peerchain, "lane must in range [0,255]");
+      eosio::check( _lanecfg.find( peerchain_name.value ) != _lanecfg.end(), "call setlanes first");
+
+      auto _symlanes = symlanes_table( _self, peerchain_name.value );
+      auto itr = _symlanes.find( symcode.raw() );
+      if ( itr == _symlanes.end() ){
+         _symlanes.emplace( _self, [&]( auto& r ){
+            r.sym_code = symcode;
+            r.lane     = lane;
+         });
+      } else {
+         _symlanes.modify( itr, same_payer, [&]( auto& r ){ r.lane = lane; });
+      }
+      update_lanes_floor( peerchain_name );
+   }
+
+   void token::delsymlane( name peerchain_name, symbol_code symcode ){
+      check_admin_auth();
+      check_lanes_changeable( peerchain_name );
+
+      auto _symlanes = symlanes_table( _self, peerchain_name.value );
+      const auto& r = _symlanes.get( symcode.raw(), "symbol lane not found");
+      _symlanes.erase( r );
+      update_lanes_floor( peerchain_name );
+   }
+
    void token::regacpttoken( name        original_contract,
                              asset       max_accept,
                              asset       min_once_transfer,
@@ -501,14 +565,29 @@ namespace eosio {
    void token::transfer_notify( name token_contract, name from, name to, asset quantity, string memo ) {
       eosio::check( to == _self, "to is not this contract");
 
-      // Make sure that the action is the outermost action, so it need to compare all the parameters one by one
+      if ( from == _proxy_st.proxy && memo == proxy_batch_memo ){
+         proxy_batch_notify( token_contract, quantity );
+         return;
+      }
+
+      auto trx_id = get_outermost_transfer_trx_id( from, to, quantity, memo );
+
+      if ( memo.find("local") == 0 ){
+         return;
+      }
+
+      ibc_transfer_notify( token_contract, from, quantity, get_memo_info( memo ), trx_id );
+   }
+
+   // Make sure that the action is the outermost action, so it need to compare all the parameters one by one
+   checksum256 token::get_outermost_transfer_trx_id( name from, name to, const asset& quantity, const string& memo ) {
       checksum256 trx_id;
       {
          std::vector<char> trx_bytes;
          size_t trx_size = transaction_size();
          trx_bytes.resize(trx_size);
          read_transaction(trx_bytes.data(), trx_size);
-         assert_sha256( trx_bytes.data(), trx_size, trx_id );
+         ibc_assert_sha256( trx_bytes.data(), trx_size, trx_id );
          auto trx = unpack<transaction>(trx_bytes.data(), trx_size);
          eosio::check( trx.actions.size() == 1, "Fatal: inline action not supported: transction contains more then one action");
          auto first_action = trx.actions.front();
@@ -517,15 +596,14 @@ namespace eosio {
          eosio::check(args.from == from && args.to == to &&
                       args.quantity == quantity && args.memo == memo, "Fatal: inline action not supported");
       }
+      return trx_id;
+   }
 
-      if ( memo.find("local") == 0 ){
-         return;
-      }
-
+   void token::ibc_transfer_notify( name token_contract, name from, const asset& quantity, const memo_info_type& info, const checksum256& trx_id ) {
       // check ibc proxy account
       name real_from = from;
       if( from == _proxy_st.proxy ){
-         name orig_from = name( get_value_str_by_key_str( memo, key_orig_from ));
+         name orig_from = memo_value_to_name( info, info.orig_from );
          eosio::check( is_account(orig_from), "orig_from account not exist");
          real_from = orig_from;
       }
@@ -533,85 +611,71 @@ namespace eosio {
       // check global active
       eosio::check( _gstate.active, "global not active" );
 
-      auto info = get_memo_info( memo );
       eosio::check( info.receiver != name(),"receiver not provide");
       auto pch = _peerchains.get( info.peerchain.value, "peerchain not registered");
 
       // check chain active
       eosio::check( pch.active, "peer chain is not active");
 
-      const auto& acpt = get_currency_accept( quantity.symbol.code() );
-      eosio::check( acpt.active, "not active");
+      ibc_transfer_accounting( token_contract, info.peerchain, quantity );
+      check_max_original_trxs_per_block( pch );
 
-      eosio::check( token_contract == acpt.original_contract, "original_contract does not match");
-      eosio::check( quantity.symbol == acpt.accept.symbol, "symbol does not match");
-      eosio::check( quantity.amount >= acpt.min_once_transfer.amount, "quantity less then min_once_transfer");
-      eosio::check( quantity.amount <= acpt.max_once_transfer.amount, "quantity greater then max_once_transfer");
+      origtrxs_emplace( info.peerchain, transfer_action_info{ token_contract, real_from, quantity }, trx_id );
+   }
 
-      // accumulate max_tfs_per_minute and check
-      auto current_time_sec = (uint32_t)(eosio::current_time_point().sec_since_epoch());
-      uint32_t limit = acpt.max_tfs_per_minute > 0 ? acpt.max_tfs_per_minute : default_max_trxs_per_minute_per_token;
-      if ( current_time_sec > acpt.mutables.minute_trx_start + 60 ){
-         _accepts.modify( acpt, same_payer, [&]( auto& r ) {
-            r.mutables.minute_trx_start = current_time_sec;
-            r.mutables.minute_trxs = 1;
-         });
-      } else {
-         _accepts.modify( acpt, same_payer, [&]( auto& r ) {
-            r.mutables.minute_trxs += 1;
-         });
+   /**
+    * the proxy transferred the total of a forwardbatch to this contract, the forwardbatch must be the only action
+    * of its transaction, one original transaction record is added for each item, like a bundletransfer.
+    */
+   void token::proxy_batch_notify( name token_contract, const asset& quantity ) {
+      checksum256 trx_id;
+      forwardbatch_action_type batch;
+      {
+         std::vector<char> trx_bytes;
+         size_t trx_size = transaction_size();
+         trx_bytes.resize(trx_size);
+         read_transaction(trx_bytes.data(), trx_size);
+         ibc_assert_sha256( trx_bytes.data(), trx_size, trx_id );
+         auto trx = unpack<transaction>(trx_bytes.data(), trx_size);
+         eosio::check( trx.actions.size() == 1, "forwardbatch must be the only action of its transaction");
+         eosio::check( trx.actions.front().account == _proxy_st.proxy && trx.actions.front().name == "forwardbatch"_n, "proxy batch transfer must be sent by forwardbatch");
+         batch = unpack<forwardbatch_action_type>( trx.actions.front().data );
       }
-      eosio::check( acpt.mutables.minute_trxs <= limit,"max transactions per minute exceed" );
 
-      // accumulate max_daily_transfer and check
-      if ( acpt.max_daily_transfer.amount != 0 ) {
-         if ( current_time_sec > acpt.mutables.daily_tf_start + 3600 * 24 ){
-            _accepts.modify( acpt, same_payer, [&]( auto& r ) {
-               r.mutables.daily_tf_start = current_time_sec;
-               r.mutables.daily_tf_sum = quantity;
-            });
-         } else {
-            _accepts.modify( acpt, same_payer, [&]( auto& r ) {
-               r.mutables.daily_tf_sum += quantity;
-            });
-         }
-         eosio::check( acpt.mutables.daily_tf_sum <= acpt.max_daily_transfer,"max daily transfer exceed" );
-      }
+      eosio::check( _gstate.active, "global not active" );
+      eosio::check( 0 < batch.items.size() && batch.items.size() <= max_bundle_items, "bundle items count must in range [1,50]");
+      eosio::check( batch.orig_froms.size() == batch.items.size(), "orig_froms and items must have the same size");
 
-      // accumulate max_original_trxs_per_block and check
-      auto& pchm = _peerchainm.get(info.peerchain.value);
-      if ( get_block_time_slot() == pchm.current_block_time_slot ) {
-         _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
-            r.current_block_trxs += 1;
-         });
-         eosio::check( pchm.current_block_trxs <= pch.max_original_trxs_per_block, "max_original_trxs_per_block exceed" );
-      } else {
-         _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
-            r.current_block_time_slot = get_block_time_slot();
-            r.current_block_trxs = 1;
-         });
-      }
+      auto pch = _peerchains.get( batch.peerchain_name.value, "peerchain not registered");
+      eosio::check( pch.active, "peer chain is not active");
 
-      auto _chainassets = chainassets_table( _self, info.peerchain.value );
-      auto itr = _chainassets.find( quantity.symbol.code().raw() );
-      if ( itr == _chainassets.end() ){
-         _chainassets.emplace( _self, [&]( auto& chain ){
-            chain.balance = quantity;
-         });
-      } else {
-         _chainassets.modify( itr, same_payer, [&]( auto& chain ) {
-            chain.balance += quantity;
-         });
+      bool ibc_withdraw = false;
+      auto itr = _stats.find( quantity.symbol.code().raw() );
+      if ( itr != _stats.end() && batch.peerchain_name == itr->peerchain_name ){
+         ibc_withdraw = true;
       }
 
-      _accepts.modify( acpt, same_payer, [&]( auto& r ) {
-         r.accept += quantity;
-         r.total_transfer += quantity;
-         r.total_transfer_times += 1;
-      });
-      eosio::check( acpt.accept.amount <= acpt.max_accept.amount, "acpt.accept.amount <= acpt.max_accept.amount assert failed");
+      check_max_original_trxs_per_block( pch, batch.items.size() );
 
-      origtrxs_emplace( info.peerchain, transfer_action_info{ token_contract, real_from, quantity }, trx_id );
+      asset total( 0, quantity.symbol );
+      for ( size_t i = 0; i < batch.items.size(); ++i ){
+         const auto& item = batch.items[i];
+         eosio::check( item.receiver != name(), "receiver not provide");
+         eosio::check( item.quantity.is_valid(), "invalid quantity" );
+         eosio::check( item.quantity.amount > 0, "must transfer positive quantity" );
+         eosio::check( item.quantity.symbol == quantity.symbol, "all items of a bundle must have the same symbol" );
+         eosio::check( item.notes.size() <= 250, "notes has more than 250 bytes" );
+         eosio::check( is_account(batch.orig_froms[i]), "orig_from account not exist");
+
+         if ( ibc_withdraw ){
+            ibc_withdraw_accounting( batch.peerchain_name, item.quantity );
+         } else {
+            ibc_transfer_accounting( token_contract, batch.peerchain_name, item.quantity );
+         }
+         total += item.quantity;
+         origtrxs_emplace( batch.peerchain_name, transfer_action_info{ token_contract, batch.orig_froms[i], item.quantity }, trx_id );
+      }
+      eosio::check( total == quantity, "quantity must equal to the total of the forwardbatch items");
    }
 
    /**
@@ -652,6 +716,15 @@ namespace eosio {
 
       bool transfered = false;
 
+      /// @tag 1: important 'to == _self' logic, avoid inline invoke action 'transfer_notify' or 'withdraw'
+      /// the memo is parsed only once here and passed down
+      bool proxy_batch = to == _self && from == _proxy_st.proxy && memo == proxy_batch_memo;
+      bool ibc_transfer = to == _self && ! proxy_batch && memo.find("local") != 0;
+      memo_info_type info;
+      if ( ibc_transfer ){
+         info = get_memo_info( memo );
+      }
+
 #ifndef HUB
       require_auth( from );
       const auto& st = _stats.get( sym.raw(), "symbol(token) not registered");
@@ -667,7 +740,8 @@ namespace eosio {
             require_auth( from );
          }else {
             eosio::check( to == _self, "the to account of hub transfer must be _self");
-            ibc_transfer_from_hub( to, quantity, memo );
+            eosio::check( ibc_transfer, "memo of hub transfer can not start with local" );
+            ibc_transfer_from_hub( to, quantity, info );
 
             auto itr = _accepts.find(sym.raw());
             if( itr != _accepts.end() && _stats.find(sym.raw()) == _stats.end() ) {
@@ -678,8 +752,11 @@ namespace eosio {
       }
 #endif
       /// --- ibc related logic ---
-      if (  to == _self && memo.find("local") != 0 ) {   /// @tag 1: important 'to == _self' logic, avoid inline invoke action 'transfer_notify' or 'withdraw'
-         auto info = get_memo_info( memo );
+      if ( proxy_batch ) {
+         proxy_batch_notify( _self, quantity );
+      }
+
+      if ( ibc_transfer ) {
          eosio::check( info.receiver != name(), "receiver not provide");
 
          if ( info.peerchain == _gstate.this_chain ){ // The purpose of this logic is to unify the action call format
@@ -698,9 +775,14 @@ namespace eosio {
 
          auto itr = _stats.find(sym.raw());
          if ( itr != _stats.end() && info.peerchain == itr->peerchain_name ){
-            withdraw( from, info.peerchain, info.receiver, quantity, info.notes );
+            withdraw( from, info, quantity );
          } else {
-            transfer_notify( _self, from, _self, quantity, memo );
+            #ifdef HUB
+            auto trx_id = _hub_forwarding ? get_trx_id() : get_outermost_transfer_trx_id( from, to, quantity, memo );
+            #else
+            auto trx_id = get_outermost_transfer_trx_id( from, to, quantity, memo );
+            #endif
+            ibc_transfer_notify( _self, from, quantity, info, trx_id );
          }
       }
 
@@ -715,84 +797,207 @@ namespace eosio {
       }
    }
 
-   void token::withdraw( name from, name peerchain_name, name peerchain_receiver, asset quantity, string memo ) {
+   void token::withdraw( name from, const memo_info_type& info, asset quantity ) {
+      auto peerchain_name = info.peerchain;
+
       // check global state
       eosio::check( _gstate.active, "global not active" );
 
-      const auto& st = get_currency_stats( quantity.symbol.code() );
-      eosio::check( st.active, "not active");
-      eosio::check( peerchain_name == st.peerchain_name, (string("peerchain_name must be ") + st.peerchain_name.to_string()).c_str());
-
-      eosio::check( quantity.symbol == st.supply.symbol, "symbol does not match");
-      eosio::check( quantity.amount >= st.min_once_withdraw.amount, "quantity less then min_once_transfer");
-      eosio::check( quantity.amount <= st.max_once_withdraw.amount, "quantity greater then max_once_transfer");
-
       const auto& balance = get_balance( _self, from, quantity.symbol.code() );
       eosio::check( quantity.amount <= balance.amount, "overdrawn balance1");
 
-      // accumulate max_wds_per_minute and check
-      auto current_time_sec = (uint32_t)(eosio::current_time_point().sec_since_epoch());
-      auto limit = st.max_wds_per_minute > 0 ? st.max_wds_per_minute : default_max_trxs_per_minute_per_token;
+      ibc_withdraw_accounting( peerchain_name, quantity );
+      check_max_original_trxs_per_block( _peerchains.get( peerchain_name.value ) );
 
-      if ( current_time_sec > st.mutables.minute_trx_start + 60 ){
-         _stats.modify( st, same_payer, [&]( auto& r ) {
-            r.mutables.minute_trx_start = current_time_sec;
-            r.mutables.minute_trxs = 1;
-         });
+      // check ibc proxy account
+      name real_from = from;
+      if( from == _proxy_st.proxy ){
+         name orig_from = memo_value_to_name( info, info.orig_from );
+         eosio::check( is_account(orig_from), "orig_from account not exist");
+         real_from = orig_from;
+      }
+
+      origtrxs_emplace( peerchain_name, transfer_action_info{ _self, real_from, quantity }, get_trx_id() );
+   }
+
+   /**
+    * all items must have the same symbol, and the token must be a peg token withdrawn to its original chain,
+    * or an accepted token whose original contract is this contract (such as a hub token), because tokens
+    * in other contracts can only come in by a transfer notification, which must be the only action of its transaction.
+    * the per block limit is counted once for a bundle, while per token limits are counted for every item.
+    */
+   void token::bundletransfer( name from, name peerchain_name, const std::vector<bundle_item>& items ) {
+      require_auth( from );
+
+      // Make sure that the action is the outermost action, so that the peer chain can find it in the transaction
+      checksum256 trx_id;
+      {
+         std::vector<char> trx_bytes;
+         size_t trx_size = transaction_size();
+         trx_bytes.resize(trx_size);
+         read_transaction(trx_bytes.data(), trx_size);
+         ibc_assert_sha256( trx_bytes.data(), trx_size, trx_id );
+         auto trx = unpack<transaction>(trx_bytes.data(), trx_size);
+         eosio::check( trx.actions.size() == 1, "bundletransfer must be the only action of its transaction");
+         eosio::check( trx.actions.front().account == _self && trx.actions.front().name == "bundletransfer"_n, "inline bundletransfer not supported");
+      }
+
+      eosio::check( _gstate.active, "global not active" );
+      eosio::check( from != _proxy_st.proxy, "proxy account can not use bundletransfer" );
+      eosio::check( 0 < items.size() && items.size() <= max_bundle_items, "bundle items count must in range [1,50]");
+
+      auto pch = _peerchains.get( peerchain_name.value, "peerchain not registered");
+      eosio::check( pch.active, "peer chain is not active");
+
+      auto sym = items.front().quantity.symbol;
+      bool ibc_withdraw = false;
+      auto itr = _stats.find( sym.code().raw() );
+      if ( itr != _stats.end() && peerchain_name == itr->peerchain_name ){
+         ibc_withdraw = true;
       } else {
-         _stats.modify( st, same_payer, [&]( auto& r ) {
-            r.mutables.minute_trxs += 1;
-         });
+         eosio::check( get_currency_accept( sym.code() ).original_contract == _self, "bundletransfer only supports tokens issued by this contract");
       }
-      eosio::check( st.mutables.minute_trxs <= limit, "max transactions per minute exceed" );
 
-      // accumulate max_daily_withdraw and check
-      if ( st.max_daily_withdraw.amount != 0 ) {
-         if ( current_time_sec > st.mutables.daily_wd_start + 3600 * 24 ){
-            _stats.modify( st, same_payer, [&]( auto& r ) {
-               r.mutables.daily_wd_start = current_time_sec;
-               r.mutables.daily_wd_sum = quantity;
-            });
+      check_max_original_trxs_per_block( pch, items.size() );
+
+      asset total( 0, sym );
+      for ( const auto& item : items ){
+         eosio::check( item.receiver != name(), "receiver not provide");
+         eosio::check( item.quantity.is_valid(), "invalid quantity" );
+         eosio::check( item.quantity.amount > 0, "must transfer positive quantity" );
+         eosio::check( item.quantity.symbol == sym, "all items of a bundle must have the same symbol" );
+         eosio::check( item.notes.size() <= 250, "notes has more than 250 bytes" );
+
+         if ( ibc_withdraw ){
+            ibc_withdraw_accounting( peerchain_name, item.quantity );
          } else {
-            _stats.modify( st, same_payer, [&]( auto& r ) {
-               r.mutables.daily_wd_sum += quantity;
-            });
+            ibc_transfer_accounting( _self, peerchain_name, item.quantity );
          }
-         eosio::check( st.mutables.daily_wd_sum <= st.max_daily_withdraw,"max daily withdraw exceed" );
+         total += item.quantity;
+         origtrxs_emplace( peerchain_name, transfer_action_info{ _self, from, item.quantity }, trx_id );
       }
 
-      // accumulate max_original_trxs_per_block and check
-      auto pch = _peerchains.get( peerchain_name.value );
-      auto& pchm = _peerchainm.get( peerchain_name.value );
-      if ( get_block_time_slot() == pchm.current_block_time_slot ) {
-         _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
-            r.current_block_trxs += 1;
+      require_recipient( from );
+      sub_balance( from, total );
+      add_balance( _self, total, _self );
+   }
+
+   void token::ibc_transfer_accounting( name token_contract, name peerchain_name, const asset& quantity ) {
+      const auto& acpt = get_currency_accept( quantity.symbol.code() );
+      eosio::check( acpt.active, "not active");
+
+      eosio::check( token_contract == acpt.original_contract, "original_contract does not match");
+      eosio::check( quantity.symbol == acpt.accept.symbol, "symbol does not match");
+      eosio::check( quantity.amount >= acpt.min_once_transfer.amount, "quantity less then min_once_transfer");
+      eosio::check( quantity.amount <= acpt.max_once_transfer.amount, "quantity greater then max_once_transfer");
+
+      auto _chainassets = chainassets_table( _self, peerchain_name.value );
+      auto itr = _chainassets.find( quantity.symbol.code().raw() );
+      if ( itr == _chainassets.end() ){
+         _chainassets.emplace( _self, [&]( auto& chain ){
+            chain.balance = quantity;
          });
-         eosio::check( pchm.current_block_trxs <= pch.max_original_trxs_per_block, "max_original_trxs_per_block exceed" );
       } else {
-         _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
-            r.current_block_time_slot = get_block_time_slot();
-            r.current_block_trxs = 1;
+         _chainassets.modify( itr, same_payer, [&]( auto& chain ) {
+            chain.balance += quantity;
          });
       }
 
+      // check the rate limits and accumulate in one modify
+      auto now = eosio::current_time_point().sec_since_epoch();
+      int64_t limit = acpt.max_tfs_per_minute > 0 ? acpt.max_tfs_per_minute : default_max_trxs_per_minute_per_token;
+      bool trxs_ok = true, daily_ok = true;
+      _accepts.modify( acpt, same_payer, [&]( auto& r ) {
+         auto limits = r.limits.value_or();
+         trxs_ok = limits.trxs.consume( now, limit, 60, 1 );
+         if ( r.max_daily_transfer.amount != 0 ){
+            daily_ok = limits.daily_tf.consume( now, r.max_daily_transfer.amount, 3600 * 24, quantity.amount );
+         }
+         r.limits.emplace( limits );
+
+         r.accept += quantity;
+         r.total_transfer += quantity;
+         r.total_transfer_times += 1;
+      });
+      eosio::check( trxs_ok, "max transactions per minute exceed" );
+      eosio::check( daily_ok, "max daily transfer exceed" );
+      eosio::check( acpt.accept.amount <= acpt.max_accept.amount, "acpt.accept.amount <= acpt.max_accept.amount assert failed");
+   }
+
+   void token::ibc_withdraw_accounting( name peerchain_name, const asset& quantity ) {
+      const auto& st = get_currency_stats( quantity.symbol.code() );
+      eosio::check( st.active, "not active");
+      eosio::check( peerchain_name == st.peerchain_name, (string("peerchain_name must be ") + st.peerchain_name.to_string()).c_str());
+
+      eosio::check( quantity.symbol == st.supply.symbol, "symbol does not match");
+      eosio::check( quantity.amount >= st.min_once_withdraw.amount, "quantity less then min_once_transfer");
+      eosio::check( quantity.amount <= st.max_once_withdraw.amount, "quantity greater then max_once_transfer");
+
+      // check the rate limits and accumulate in one modify
+      auto now = eosio::current_time_point().sec_since_epoch();
+      int64_t limit = st.max_wds_per_minute > 0 ? st.max_wds_per_minute : default_max_trxs_per_minute_per_token;
+      bool wds_ok = true, daily_ok = true;
       _stats.modify( st, same_payer, [&]( auto& r ) {
+         auto limits = r.limits.value_or();
+         wds_ok = limits.wds.consume( now, limit, 60, 1 );
+         if ( r.max_daily_withdraw.amount != 0 ){
+            daily_ok = limits.daily_wd.consume( now, r.max_daily_withdraw.amount, 3600 * 24, quantity.amount );
+         }
+         r.limits.emplace( limits );
+
          r.supply -= quantity;
          r.total_withdraw += quantity;
          r.total_withdraw_times += 1;
+         r.stats2_dirty.emplace( true );
       });
+      eosio::check( wds_ok, "max transactions per minute exceed" );
+      eosio::check( daily_ok, "max daily withdraw exceed" );
+   }
 
-      // check ibc proxy account
-      name real_from = from;
-      if( from == _proxy_st.proxy ){
-         name orig_from = name( get_value_str_by_key_str( memo, key_orig_from ));
-         eosio::check( is_account(orig_from), "orig_from account not exist");
-         real_from = orig_from;
+   /**
+    * new_trxs original transactions are about to be recorded, a bundle is counted once per block
+    * but all of its records are counted in the backlog
+    */
+   void token::check_max_original_trxs_per_block( const peer_chain_state& pch, uint32_t new_trxs ) {
+      auto& pchm = _peerchainm.get( pch.peerchain_name.value );
+      auto slot = get_block_time_slot();
+
+      int64_t allowed = pch.max_original_trxs_per_block;
+      if ( pch.max_origtrxs_table_records != 0 ){
+         uint64_t pending = pchm.pending_origtrxs.value_or( 0 );
+         eosio::check( pending + new_trxs <= pch.max_origtrxs_table_records, "max_origtrxs_table_records exceed, relays are behind" );
+
+         allowed = std::max( int64_t(1), int64_t( allowed * admission_boost_factor * ( pch.max_origtrxs_table_records - pending ) / pch.max_origtrxs_table_records ) );
+
+         auto oldest_slot = pchm.oldest_origtrx_slot.value_or( 0 );
+         if ( pending != 0 && oldest_slot + admission_max_backlog_age < slot ){
+            allowed = std::min( allowed, int64_t(pch.max_original_trxs_per_block) );
+         }
       }
 
-      origtrxs_emplace( peerchain_name, transfer_action_info{ _self, real_from, quantity }, get_trx_id() );
+      bool ok = true;
+      _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
+         r.fill_extensions();
+         auto bucket = r.block_trxs.value_or();
+         ok = bucket.consume( slot, allowed, 1, 1 );
+         r.block_trxs.emplace( bucket );
+      });
+      eosio::check( ok, "max_original_trxs_per_block exceed" );
+   }
+
+   // called after records of table origtrxs are erased, keeps the work-queue summary fields of table peerchainm
+   void token::update_origtrxs_summary( name peerchain_name, uint64_t erased ) {
+      auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
+      auto oldest = _origtrxs.begin();
 
-      update_stats2( quantity.symbol.code() );
+      auto& pchm = _peerchainm.get( peerchain_name.value );
+      _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
+         r.fill_extensions();
+         auto pending = r.pending_origtrxs.value_or( 0 );
+         r.pending_origtrxs.emplace( pending > erased ? pending - erased : 0 );
+         r.oldest_origtrx_id.emplace( oldest != _origtrxs.end() ? oldest->id : 0 );
+         r.oldest_origtrx_slot.emplace( oldest != _origtrxs.end() ? oldest->block_time_slot : 0 );
+      });
    }
 
    void token::verify_merkle_path( const std::vector<digest_type>& merkle_path, digest_type check ) {
@@ -839,6 +1044,7 @@ namespace eosio {
                      const name&                            relay ) {
       auto pch = _peerchains.get( from_chain.value, "from_chain not registered");
       chain::require_relay_auth( pch.thischain_ibc_chain_contract, relay );
+      chain::require_relay_lease( pch.thischain_ibc_chain_contract, relay, "cash"_n, orig_trx_block_num );
 
       // check global state
       eosio::check( _gstate.active, "global not active" );
@@ -847,11 +1053,118 @@ namespace eosio {
       eosio::check( sym.is_valid(), "invalid symbol name" );
       eosio::check( memo.size() <= 256, "memo has more than 256 bytes" );
 
-      eosio::check( seq_num == get_cashtrxs_tb_max_seq_num(from_chain) + 1, "seq_num not valid");   // seq_num is important, used to enable all successful cash transactions must be successfully returned to the original chain, no one will be lost
-      eosio::check( orig_trx_block_num >= get_cashtrxs_tb_max_orig_trx_block_num(from_chain), "orig_trx_block_num error");  // important! used to prevent replay attack
-      eosio::check( false == is_orig_trx_id_exist_in_cashtrxs_tb(from_chain, orig_trx_id), "orig_trx_id already exist");      // important! used to prevent replay attack
+      auto lane = get_lane( from_chain, sym.code() );
+      check_cash_replay( from_chain, lane, seq_num, orig_trx_id, orig_trx_block_num );
+
+      const transaction_receipt& trx_receipt = unpack<transaction_receipt>( orig_trx_packed_trx_receipt );
+      action actn = get_orig_trx_action( trx_receipt, orig_trx_id );
+      transfer_action_type args = get_transfer_from_action( actn, pch.peerchain_ibc_token_contract );
+
+      // check action parameters
+      eosio::check( args.to == pch.peerchain_ibc_token_contract, "transfer to account not correct" );
+      eosio::check( args.quantity == quantity, "quantity not equal to quantity within packed transaction" );
+      memo_info_type memo_info = get_memo_info( args.memo );
+
+      eosio::check( to == memo_info.receiver, "to not equal to receiver，which provided in memo string" );
+      eosio::check( is_account( to ), "to account does not exist");
+      eosio::check( memo_info.peerchain == _gstate.this_chain, "peer chain name in orignal trx must be this chain's name");
+
+      verify_orig_trx_inclusion( pch, trx_receipt.digest(), orig_trx_merkle_path, orig_trx_block_num,
+                                 orig_trx_block_header_data, orig_trx_block_id_merkle_path, anchor_block_num );
+
+      bool from_free_account = false;
+      auto itr2 = _freeaccount.find( from_chain.value);
+      if ( itr2 != _freeaccount.end() && args.from == itr2->peerchain_account ){
+         from_free_account = true;
+      }
+
+      auto payout = cash_payout( pch, actn.account, to, quantity, string( memo_info.notes ), from_free_account );
+      accrue_relay_fee( relay, payout.fee, payout.token_contract );
+
+      #ifdef HUB
+      if ( _hubgs.is_open && to == _hubgs.hub_account ){
+         ibc_cash_to_hub( seq_num, from_chain, args.from, orig_trx_id, payout.quantity, memo_info.notes, from_free_account );
+      }
+      #endif
+
+      trim_cashblks_table_or_not( from_chain, lane.lane );
+
+      // record to cash table
+      cashblks_emplace( from_chain, lane.lane, orig_trx_block_num, cash_trx_entry{ seq_num, get_block_time_slot(), get_trx_id(), orig_trx_id } );
+      emit_event( "evcash"_n, from_chain, lane.lane, seq_num, orig_trx_id );
+   }
+
+   void token::cashbundle( const uint64_t&                        seq_num,
+                           const name&                            from_chain,
+                           const transaction_id_type&             orig_trx_id,
+                           const std::vector<char>&               orig_trx_packed_trx_receipt,
+                           const std::vector<checksum256>&        orig_trx_merkle_path,
+                           const uint32_t&                        orig_trx_block_num,
+                           const std::vector<char>&               orig_trx_block_header_data,
+                           const std::vector<checksum256>&        orig_trx_block_id_merkle_path,
+                           const uint32_t&                        anchor_block_num,
+                           const name&                            relay ) {
+      auto pch = _peerchains.get( from_chain.value, "from_chain not registered");
+      chain::require_relay_auth( pch.thischain_ibc_chain_contract, relay );
+      chain::require_relay_lease( pch.thischain_ibc_chain_contract, relay, "cash"_n, orig_trx_block_num );
+
+      // check global state
+      eosio::check( _gstate.active, "global not active" );
+
+      const transaction_receipt& trx_receipt = unpack<transaction_receipt>( orig_trx_packed_trx_receipt );
+      action actn = get_orig_trx_action( trx_receipt, orig_trx_id );
+      auto bundle = get_bundle_from_action( actn, pch );
+      eosio::check( bundle.peerchain_name == _gstate.this_chain, "peer chain name in orignal trx must be this chain's name");
+
+      auto sym = bundle.items.front().quantity.symbol;
+      auto lane = get_lane( from_chain, sym.code() );
+      check_cash_replay( from_chain, lane, seq_num, orig_trx_id, orig_trx_block_num );
+
+      verify_orig_trx_inclusion( pch, trx_receipt.digest(), orig_trx_merkle_path, orig_trx_block_num,
+                                 orig_trx_block_header_data, orig_trx_block_id_merkle_path, anchor_block_num );
+
+      bool from_free_account = false;
+      auto itr2 = _freeaccount.find( from_chain.value);
+      if ( itr2 != _freeaccount.end() && bundle.from == itr2->peerchain_account ){
+         from_free_account = true;
+      }
+
+      cash_payout_info total;
+      for ( const auto& item : bundle.items ){
+         eosio::check( is_account( item.receiver ), "receiver account does not exist");
+         #ifdef HUB
+         eosio::check( ! _hubgs.is_open || item.receiver != _hubgs.hub_account, "bundle receiver can not be hub account");
+         #endif
+
+         auto payout = cash_payout( pch, actn.account, item.receiver, item.quantity, item.notes, from_free_account );
+         if ( total.token_contract == name() ){
+            total = payout;
+         } else {
+            total.quantity += payout.quantity;
+            total.fee += payout.fee;
+         }
+      }
+
+      accrue_relay_fee( relay, total.fee, total.token_contract );
+
+      trim_cashblks_table_or_not( from_chain, lane.lane );
+
+      // record to cash table
+      cashblks_emplace( from_chain, lane.lane, orig_trx_block_num, cash_trx_entry{ seq_num, get_block_time_slot(), get_trx_id(), orig_trx_id } );
+      emit_event( "evcash"_n, from_chain, lane.lane, seq_num, orig_trx_id );
+   }
+
+   void token::check_cash_replay( name from_chain, const lane_info& lane, uint64_t seq_num, const transaction_id_type& orig_trx_id, uint32_t orig_trx_block_num ) {
+      auto _cashtrxs = cashtrxs_table( _self, from_chain.value );
+      eosio::check( _cashtrxs.begin() == _cashtrxs.end(), "legacy cashtrxs table not empty, call mvcashtrxs first");   // important! records not moved are invisible to the checks below
+
+      eosio::check( seq_num == get_cashblks_tb_max_seq_num(from_chain, lane.lane) + 1, "seq_num not valid");   // seq_num is important, used to enable all successful cash transactions must be successfully returned to the original chain, no one will be lost
+      eosio::check( orig_trx_block_num >= get_cashblks_tb_max_orig_trx_block_num(from_chain, lane.lane), "orig_trx_block_num error");  // important! used to prevent replay attack
+      eosio::check( orig_trx_block_num > lane.orig_trx_block_num_floor, "orig_trx_block_num not above lanes floor");  // important! used to prevent replay attack after lanes changed
+      eosio::check( false == is_orig_trx_id_exist_in_cashblks_tb(from_chain, lane.lane, orig_trx_block_num, orig_trx_id), "orig_trx_id already exist");      // important! used to prevent replay attack
+   }
 
-      const transaction_receipt& trx_receipt = unpack<transaction_receipt>( orig_trx_packed_trx_receipt );
+   action token::get_orig_trx_action( const transaction_receipt& trx_receipt, const transaction_id_type& orig_trx_id ) {
       eosio::check( trx_receipt.status == transaction_receipt::executed, "trx_receipt.status must be executed");
       packed_transaction pkd_trx = std::get<packed_transaction>(trx_receipt.trx);
       transaction trxn = unpack<transaction>( pkd_trx.packed_trx );
@@ -859,22 +1172,17 @@ namespace eosio {
 
       // validate transaction id
       eosio::check( orig_trx_id == pkd_trx.id(), "transaction id mismatch");
+      return trxn.actions.front();
+   }
 
-      // check transfer action
-      action actn = trxn.actions.front();
-      transfer_action_type args = unpack<transfer_action_type>( actn.data );
-
-      // check action parameters
-      eosio::check( args.to == pch.peerchain_ibc_token_contract, "transfer to account not correct" );
-      eosio::check( args.quantity == quantity, "quantity not equal to quantity within packed transaction" );
-      memo_info_type memo_info = get_memo_info( args.memo );
-
-      eosio::check( to == memo_info.receiver, "to not equal to receiver，which provided in memo string" );
-      eosio::check( is_account( to ), "to account does not exist");
-      eosio::check( memo_info.peerchain == _gstate.this_chain, "peer chain name in orignal trx must be this chain's name");
-
+   void token::verify_orig_trx_inclusion( const peer_chain_state& pch, const digest_type& receipt_digest,
+                                          const std::vector<checksum256>& orig_trx_merkle_path,
+                                          uint32_t orig_trx_block_num,
+                                          const std::vector<char>& orig_trx_block_header_data,
+                                          const std::vector<checksum256>& orig_trx_block_id_merkle_path,
+                                          uint32_t anchor_block_num ) {
       // validate merkle path
-      verify_merkle_path( orig_trx_merkle_path, trx_receipt.digest() );
+      verify_merkle_path( orig_trx_merkle_path, receipt_digest );
 
       // --- validate with lwc ---
       eosio::check( orig_trx_block_num <= anchor_block_num, "orig_trx_block_num <= anchor_block_num assert failed");
@@ -888,17 +1196,102 @@ namespace eosio {
       } else { // orig_trx_block_num < anchor_block_num
          chain::assert_anchor_block_and_transaction_mroot( pch.thischain_ibc_chain_contract, anchor_block_num, orig_trx_merkle_path.back() );
       }
+   }
+
+   // the original action of a cash is a transfer, or a cashfwd of the ibc.token contract of a hub chain which carries the forward transfer
+   transfer_action_type token::get_transfer_from_action( const action& actn, name ibc_token_contract ) {
+      if ( actn.name == "cashfwd"_n ){
+         eosio::check( actn.account == ibc_token_contract, "original action is not a cashfwd of the ibc.token contract");
+         return unpack<cashfwd_action_type>( actn.data ).forward;
+      }
+      return unpack<transfer_action_type>( actn.data );
+   }
+
+   // the original action of a cashbundle is a bundletransfer, or a forwardbatch of the peer chain ibc.proxy which starts with a bundle
+   bundle_action_type token::get_bundle_from_action( const action& actn, const peer_chain_state& pch ) {
+      if ( actn.name == "forwardbatch"_n ){
+         auto pch2_ptr = _peerchains2.find( pch.peerchain_name.value );
+         eosio::check( pch2_ptr != _peerchains2.end() && actn.account == pch2_ptr->proxy_account, "original action is not a forwardbatch of peer chain ibc.proxy contract");
+      } else {
+         eosio::check( actn.account == pch.peerchain_ibc_token_contract && actn.name == "bundletransfer"_n, "original action is not a bundletransfer of peer chain ibc.token contract");
+      }
+      bundle_action_type bundle = unpack<bundle_action_type>( actn.data );
+      eosio::check( 0 < bundle.items.size() && bundle.items.size() <= max_bundle_items, "bundle items count must in range [1,50]");
+      for ( const auto& item : bundle.items ){
+         eosio::check( item.quantity.symbol == bundle.items.front().quantity.symbol, "all items of a bundle must have the same symbol" );
+      }
+      return bundle;
+   }
+
+   /**
+    * 'ibc_transfer' means send a token from its original issued chain to its peg-token chain.
+    * 'ibc_withdraw' means send a token from its  peg-token chain to its original issued chain.
+    *
+    * If the symbol code is not registered in table '_stats', this is a ibc_withdraw.
+    * If the symbol code is registered in table '_stats', means that it must be a pegtoken, then check whether the
+    * original chain of the symbol recorded in table '_stats' is same with parameter 'from_chain' of the
+    * action 'cash(...)', if they are the same, it's ibc_transfer, otherwise, it's ibc_withdraw.
+    */
+   void token::accrue_relay_fee( name relay, const asset& fee, name token_contract ) {
+      if ( relay == _self || fee.amount == 0 ){
+         return;
+      }
+
+      relayfees_table _relayfees( _self, relay.value );
+      auto itr = _relayfees.find( fee.symbol.code().raw() );
+      if ( itr == _relayfees.end() ){
+         _relayfees.emplace( _self, [&]( auto& r ){
+            r.balance         = fee;
+            r.token_contract  = token_contract;
+         });
+      } else {
+         _relayfees.modify( itr, same_payer, [&]( auto& r ){
+            r.balance += fee;
+         });
+      }
+   }
+
+   void token::cashnotify( name from, name to, asset quantity, string memo ){
+      require_auth( _self );
+      require_recipient( to );
+   }
+
+   void token::evorigtrx( name peerchain_name, uint64_t id, const transaction_id_type& trx_id, const asset& quantity ){
+      require_auth( _self );
+      if ( _events_st.log_account != name() ){ require_recipient( _events_st.log_account ); }
+   }
+
+   void token::evcash( name peerchain_name, uint32_t lane, uint64_t seq_num, const transaction_id_type& orig_trx_id ){
+      require_auth( _self );
+      if ( _events_st.log_account != name() ){ require_recipient( _events_st.log_account ); }
+   }
+
+   void token::evconfirm( name peerchain_name, uint32_t lane, uint64_t seq_num, const transaction_id_type& orig_trx_id ){
+      require_auth( _self );
+      if ( _events_st.log_account != name() ){ require_recipient( _events_st.log_account ); }
+   }
+
+   void token::evrollback( name peerchain_name, const transaction_id_type& trx_id, const asset& refund ){
+      require_auth( _self );
+      if ( _events_st.log_account != name() ){ require_recipient( _events_st.log_account ); }
+   }
+
+   void token::claimfees( name relay, const symbol_code& symcode ) {
+      require_auth( relay );
+
+      relayfees_table _relayfees( _self, relay.value );
+      const auto& fee = _relayfees.get( symcode.raw(), "no fees accrued for this symbol" );
+
+      transfer_action_type action_data{ _self, relay, fee.balance, "send ibc trx fee to relay account" };
+      send_inline( action( permission_level{ _self, "active"_n }, fee.token_contract, "transfer"_n, action_data ) );
+
+      _relayfees.erase( fee );
+   }
+
+   token::cash_payout_info token::cash_payout( const peer_chain_state& pch, name orig_account, name to, const asset& quantity, string notes, bool from_free_account ) {
+      const name& from_chain = pch.peerchain_name;
+      auto sym = quantity.symbol;
 
-      asset new_quantity;
-      /**
-       * 'ibc_transfer' means send a token from its original issued chain to its peg-token chain.
-       * 'ibc_withdraw' means send a token from its  peg-token chain to its original issued chain.
-       *
-       * If the symbol code is not registered in table '_stats', this is a ibc_withdraw.
-       * If the symbol code is registered in table '_stats', means that it must be a pegtoken, then check whether the
-       * original chain of the symbol recorded in table '_stats' is same with parameter 'from_chain' of the
-       * action 'cash(...)', if they are the same, it's ibc_transfer, otherwise, it's ibc_withdraw.
-       */
       bool ibc_transfer = false;
       {
          auto itr = _stats.find( sym.code().raw() );
@@ -907,24 +1300,18 @@ namespace eosio {
          }
       }
 
-      bool from_free_account = false;
-      auto itr2 = _freeaccount.find( from_chain.value);
-      if ( itr2 != _freeaccount.end() && args.from == itr2->peerchain_account ){
-         from_free_account = true;
-      }
-
-
       name peerchain_proxy_account = pch.peerchain_ibc_token_contract;
       auto pch2_ptr = _peerchains2.find( from_chain.value);
       if ( pch2_ptr != _peerchains2.end() ){
          peerchain_proxy_account = pch2_ptr->proxy_account;
       }
-      
+
+      cash_payout_info payout;
       if ( ibc_transfer ){   // issue peg token to user
          const auto& st = get_currency_stats( sym.code() );
          eosio::check( st.active, "not active");
          eosio::check( st.peerchain_name == from_chain, "from_chain must equal to st.peerchain_name");
-         eosio::check( actn.account == st.peerchain_contract || actn.account == pch.peerchain_ibc_token_contract || actn.account == peerchain_proxy_account,
+         eosio::check( orig_account == st.peerchain_contract || orig_account == pch.peerchain_ibc_token_contract || orig_account == peerchain_proxy_account,
                "action.account not equal to st.peerchain_contract or pch.peerchain_ibc_token_contract or peerchain_proxy_account.");
 
          eosio::check( quantity.is_valid(), "invalid quantity" );
@@ -932,16 +1319,15 @@ namespace eosio {
          eosio::check( quantity.symbol.precision() == st.supply.symbol.precision(), "symbol precision mismatch" );
          eosio::check( quantity.amount <= st.max_supply.amount - st.supply.amount, "quantity exceeds available supply");
 
-         new_quantity = asset( quantity.amount, st.supply.symbol );
+         auto new_quantity = asset( quantity.amount, st.supply.symbol );
 
          _stats.modify( st, same_payer, [&]( auto& s ) {
             s.supply += new_quantity;
             s.total_issue += new_quantity;
             s.total_issue_times += 1;
+            s.stats2_dirty.emplace( true );
          });
 
-         add_balance( _self, new_quantity, _self );
-
          int64_t diff = 0;
          if ( to != pch.thischain_free_account && (! from_free_account) ){
             if ( st.service_fee_mode == "fixed"_n ){
@@ -959,29 +1345,31 @@ namespace eosio {
          final_quantity.amount = new_quantity.amount > diff ? new_quantity.amount - diff : 1; // 1 is used to avoid withdraw failure
          fee_quantity.amount = new_quantity.amount - final_quantity.amount;
 
-         if ( relay != _self ){
-            transfer_action_type action_data{ _self, relay, fee_quantity, "send ibc trx fee to relay account." };
-            action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ).send();
-         }
-
+         // credit the receiver in place, the fee is held by _self for the relay fee ledger
          if( to != _self ) {  /// @tag 1: important 'to != _self' logic, avoid inline invoke action 'transfer_notify' or 'withdraw'
-            if ( memo_info.notes.size() > 250 ) memo_info.notes.resize( 250 );
-            transfer_action_type action_data{ _self, to, final_quantity, memo_info.notes };
-            action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ).send();
+            add_balance( to, final_quantity, _self );
+            if ( fee_quantity.amount > 0 ){
+               add_balance( _self, fee_quantity, _self );
+            }
+            if ( notes.size() > 250 ) notes.resize( 250 );
+            transfer_action_type action_data{ _self, to, final_quantity, notes };
+            send_inline( action( permission_level{ _self, "active"_n }, _self, "cashnotify"_n, action_data ) );
+         } else {
+            add_balance( _self, new_quantity, _self );
          }
 
-         update_stats2( st.supply.symbol.code() );
+         payout = cash_payout_info{ new_quantity, fee_quantity, _self };
       } else {  // withdraw accepted token to user
          const auto& acpt = get_currency_accept( quantity.symbol.code() );
          eosio::check( acpt.active, "not active");
-         eosio::check( actn.account == pch.peerchain_ibc_token_contract || actn.account == peerchain_proxy_account, "action.account not equal to pch.peerchain_ibc_token_contract or peerchain_proxy_account.");
+         eosio::check( orig_account == pch.peerchain_ibc_token_contract || orig_account == peerchain_proxy_account, "action.account not equal to pch.peerchain_ibc_token_contract or peerchain_proxy_account.");
 
          eosio::check( quantity.is_valid(), "invalid quantity" );
          eosio::check( quantity.amount > 0, "must issue positive quantity" );
          eosio::check( quantity.symbol.precision() == acpt.accept.symbol.precision(), "symbol precision mismatch" );
          eosio::check( quantity.amount <= acpt.accept.amount, "quantity exceeds available accept");
 
-         new_quantity = asset( quantity.amount, acpt.accept.symbol );
+         auto new_quantity = asset( quantity.amount, acpt.accept.symbol );
 
          auto _chainassets = chainassets_table( _self, from_chain.value );
          auto itr = _chainassets.find( acpt.accept.symbol.code().raw() );
@@ -1015,11 +1403,6 @@ namespace eosio {
          final_quantity.amount = new_quantity.amount > diff ? new_quantity.amount - diff : 1; // 1 is used to avoid withdraw failure
          fee_quantity.amount = new_quantity.amount - final_quantity.amount;
 
-         if ( relay != _self ){
-            transfer_action_type action_data{ _self, relay, fee_quantity, "send ibc trx fee to relay account" };
-            action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ).send();
-         }
-
          if( to != _self ) {  /// @tag 1: important 'to != _self' logic, avoid inline invoke action 'transfer_notify' or 'withdraw'
             bool jump = false;
             #ifdef HUB
@@ -1027,31 +1410,14 @@ namespace eosio {
             #endif
 
             if ( ! jump ){
-               if ( memo_info.notes.size() > 250 ) memo_info.notes.resize( 250 );
-               transfer_action_type action_data{ _self, to, final_quantity, memo_info.notes };
-               action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ).send();
+               if ( notes.size() > 250 ) notes.resize( 250 );
+               transfer_action_type action_data{ _self, to, final_quantity, notes };
+               send_inline( action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ) );
             }
          }
+         payout = cash_payout_info{ new_quantity, fee_quantity, acpt.original_contract };
       }
-
-      #ifdef HUB
-      if ( _hubgs.is_open && to == _hubgs.hub_account ){
-         ibc_cash_to_hub( seq_num, from_chain, args.from, orig_trx_id, new_quantity, memo_info.notes, from_free_account );
-      }
-      #endif
-
-      trim_cashtrxs_table_or_not( from_chain );
-
-      // record to cash table
-      auto _cashtrxs = cashtrxs_table( _self, from_chain.value );
-      _cashtrxs.emplace( _self, [&]( auto& r ) {
-            r.seq_num = seq_num;
-            r.block_time_slot = get_block_time_slot();
-            r.trx_id = get_trx_id();
-            r.action = transfer_action_type{ _self, to, new_quantity, memo };
-            r.orig_trx_id = orig_trx_id;
-            r.orig_trx_block_num = orig_trx_block_num;
-      });
+      return payout;
    }
 
    void token::cashconfirm( const name&                            from_chain,
@@ -1064,7 +1430,7 @@ namespace eosio {
                             const uint32_t&                        anchor_block_num,
                             const transaction_id_type&             orig_trx_id ) {
 
-      auto orig_action_info = get_orignal_action_by_trx_id( from_chain, orig_trx_id );
+      get_orignal_action_by_trx_id( from_chain, orig_trx_id );   // assert the original transaction exists
 
       const transaction_receipt& trx_receipt = unpack<transaction_receipt>( cash_trx_packed_trx_receipt );
       eosio::check( trx_receipt.status == transaction_receipt::executed, "trx_receipt.status must be executed");
@@ -1079,19 +1445,49 @@ namespace eosio {
       eosio::check( cash_trx_id == pkd_trx.id(), "cash_trx_id mismatch");
 
       // check issue action
-      cash_action_type args = unpack<cash_action_type>( trx.actions.front().data );
-      transaction_receipt src_tf_trx_receipt = unpack<transaction_receipt>( args.orig_trx_packed_trx_receipt );
+      bool is_bundle = trx.actions.front().name == "cashbundle"_n;
+      eosio::check( is_bundle || trx.actions.front().name == "cash"_n || trx.actions.front().name == "cashfwd"_n, "cash transaction must be cash, cashfwd or cashbundle action");
+
+      uint64_t cash_seq_num;
+      std::vector<char> orig_trx_packed_trx_receipt;
+      if ( is_bundle ){
+         cashbundle_action_type args = unpack<cashbundle_action_type>( trx.actions.front().data );
+         cash_seq_num = args.seq_num;
+         orig_trx_packed_trx_receipt = args.orig_trx_packed_trx_receipt;
+      } else {
+         cash_action_type args = unpack<cash_action_type>( trx.actions.front().data );   // also the leading part of cashfwd
+         cash_seq_num = args.seq_num;
+         orig_trx_packed_trx_receipt = args.orig_trx_packed_trx_receipt;
+      }
+      transaction_receipt src_tf_trx_receipt = unpack<transaction_receipt>( orig_trx_packed_trx_receipt );
       eosio::check( src_tf_trx_receipt.status == transaction_receipt::executed, "trx_receipt.status must be executed");
       packed_transaction src_pkd_trx = std::get<packed_transaction>(src_tf_trx_receipt.trx);
       transaction src_trx = unpack<transaction>( src_pkd_trx.packed_trx );
       eosio::check( src_trx.actions.size() == 1, "orignal transaction contains more then one action" );
       eosio::check( orig_trx_id == src_pkd_trx.id(), "orig_trx_id mismatch" );
 
-      transfer_action_type src_trx_args = unpack<transfer_action_type>( src_trx.actions.front().data );
+      symbol_code src_sym_code;
+      name src_to_chain;
+      name src_from;
+      transfer_action_type src_trx_args;
+      if ( is_bundle ){
+         const auto& src_action = src_trx.actions.front();
+         eosio::check( ( src_action.account == _self && src_action.name == "bundletransfer"_n ) ||
+                       ( src_action.account == _proxy_st.proxy && src_action.name == "forwardbatch"_n ), "orignal action of cashbundle must be bundletransfer or forwardbatch");
+         bundle_action_type src_bundle = unpack<bundle_action_type>( src_trx.actions.front().data );
+         src_sym_code = src_bundle.items.front().quantity.symbol.code();
+         src_to_chain = src_bundle.peerchain_name;
+         src_from = src_bundle.from;
+      } else {
+         src_trx_args = get_transfer_from_action( src_trx.actions.front(), _self );
+         src_sym_code = src_trx_args.quantity.symbol.code();
+         src_to_chain = get_memo_info( src_trx_args.memo ).peerchain;
+         src_from = src_trx_args.from;
+      }
 
       // check cash_seq_num
-      auto& pchm = _peerchainm.get( from_chain.value, "from_chain not registered");
-      eosio::check( args.seq_num == pchm.cash_seq_num + 1, "seq_num derived from cash_trx_packed_trx_receipt error");
+      auto lane = get_lane( from_chain, src_sym_code ).lane;
+      eosio::check( cash_seq_num == get_lane_cash_seq_num( from_chain, lane ) + 1, "seq_num derived from cash_trx_packed_trx_receipt error");
 
       // validate merkle path
       verify_merkle_path( cash_trx_merkle_path, trx_receipt.digest());
@@ -1117,11 +1513,10 @@ namespace eosio {
        */
 
       /// if orignal trx is withdraw, burn those token
-      auto memo_info = get_memo_info( src_trx_args.memo );
       bool ibc_withdraw = false;
-      auto sym_code_raw = src_trx_args.quantity.symbol.code().raw();
+      auto sym_code_raw = src_sym_code.raw();
       auto itr = _stats.find( sym_code_raw );
-      if ( itr != _stats.end() && memo_info.peerchain == itr->peerchain_name ){
+      if ( itr != _stats.end() && src_to_chain == itr->peerchain_name ){
          ibc_withdraw = true;
       }
 
@@ -1131,20 +1526,22 @@ namespace eosio {
          eosio::check( account == _self || account == acpt.original_contract || account == _proxy_st.proxy , "account should be _self or acpt.original_contract or _proxy_st.proxy");
       }
 
+      // remove record in origtrxs table, a bundle has one record for each item
+      auto confirmed_quantity = erase_record_in_origtrxs_tb_by_trx_id_for_confirmed( from_chain, orig_trx_id );
+
       if ( ibc_withdraw ){
-         sub_balance( _self, orig_action_info.quantity );
+         sub_balance( _self, confirmed_quantity );
       }
 
-      // remove record in origtrxs table
-      erase_record_in_origtrxs_tb_by_trx_id_for_confirmed( from_chain, orig_trx_id );
-
-      _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
-         r.cash_seq_num += 1;
-      });
+      increase_lane_cash_seq_num( from_chain, lane );
+      emit_event( "evconfirm"_n, from_chain, lane, cash_seq_num, orig_trx_id );
 
       #ifdef HUB
-      if ( _hubgs.is_open && src_trx_args.from == _hubgs.hub_account ){
-         delete_by_hub_trx_id( orig_trx_id );
+      if ( _hubgs.is_open && src_from == _hubgs.hub_account ){
+         if ( src_trx.actions.front().name == "cashfwd"_n ){
+            check_hub_forward_confirmed( from_chain, orig_trx_id, src_trx_args );
+         }
+         delete_by_hub_trx_id( from_chain, orig_trx_id );
       }
       #endif
    }
@@ -1155,14 +1552,16 @@ namespace eosio {
 
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       auto idx = _origtrxs.get_index<"trxid"_n>();
-      auto it = idx.find( fixed_bytes<32>(trx_id) );
+      auto it = find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.trx_id; } );
       eosio::check( it != idx.end(), "trx_id not exist");
+      chain::require_relay_lease( pch.thischain_ibc_chain_contract, relay, "rollback"_n, uint32_t(it->block_time_slot) );
 
-      eosio::check( it->block_time_slot + 25 < _peerchainm.get(peerchain_name.value).last_confirmed_orig_trx_block_time_slot, "(block_time_slot + 25 < last_confirmed_orig_trx_block_time_slot) is false");
+      auto lane = get_lane( peerchain_name, it->action.quantity.symbol.code() ).lane;
+      eosio::check( it->block_time_slot + 25 < get_lane_last_confirmed_slot( peerchain_name, lane ), "(block_time_slot + 25 < last_confirmed_orig_trx_block_time_slot) is false");
 
       transfer_action_info action_info = it->action;
       string memo = "rollback transaction: " + checksum256_to_string(trx_id);
-      print( memo.c_str() );
+      IBC_LOG_DEBUG( "%", memo );
 
       asset final_quantity(0,action_info.quantity.symbol);
 
@@ -1190,7 +1589,7 @@ namespace eosio {
 
             final_quantity = asset( action_info.quantity.amount > fee.amount ?  action_info.quantity.amount - fee.amount : 1, action_info.quantity.symbol ); // 1 is used to avoid rollback failure
             transfer_action_type action_data{ _self, action_info.from, final_quantity, memo };
-            action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ).send();
+            send_inline( action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ) );
          }
       } else { // rollback ibc withdraw
          const auto& st = get_currency_stats( action_info.quantity.symbol.code() );
@@ -1199,6 +1598,7 @@ namespace eosio {
             r.max_supply += action_info.quantity;
             r.total_withdraw -= action_info.quantity;
             r.total_withdraw_times -= 1;
+            r.stats2_dirty.emplace( true );
          });
 
          if( action_info.from != _self ) {
@@ -1210,17 +1610,17 @@ namespace eosio {
 
             final_quantity = asset( action_info.quantity.amount > fee.amount ?  action_info.quantity.amount - fee.amount : 1, action_info.quantity.symbol ); // 1 is used to avoid rollback failure
             transfer_action_type action_data{ _self, action_info.from, final_quantity, memo };
-            action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ).send();
+            send_inline( action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ) );
          }
-
-         update_stats2( st.supply.symbol.code() );
       }
 
       _origtrxs.erase( _origtrxs.find(it->id) );
+      update_origtrxs_summary( peerchain_name, 1 );
+      emit_event( "evrollback"_n, peerchain_name, trx_id, final_quantity );
 
       #ifdef HUB
-      if ( _hubgs.is_open ){
-         rollback_hub_trx( trx_id, final_quantity );
+      if ( _hubgs.is_open && action_info.from == _hubgs.hub_account ){
+         rollback_hub_trx( peerchain_name, trx_id, final_quantity );
       }
       #endif
    }
@@ -1232,13 +1632,14 @@ namespace eosio {
 
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       auto idx = _origtrxs.get_index<"trxid"_n>();
-      auto it = idx.find( fixed_bytes<32>(trx_id) );
+      auto it = find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.trx_id; } );
       eosio::check( it != idx.end(), "trx_id not exist");
 
-      auto pchm = _peerchainm.get( peerchain_name.value, "peerchain not found");
-      eosio::check( it->block_time_slot + min_distance < pchm.last_confirmed_orig_trx_block_time_slot, "(block_time_slot + min_distance < _gmutable.last_confirmed_orig_trx_block_time_slot) is false");
+      auto lane = get_lane( peerchain_name, it->action.quantity.symbol.code() ).lane;
+      eosio::check( it->block_time_slot + min_distance < get_lane_last_confirmed_slot( peerchain_name, lane ), "(block_time_slot + min_distance < _gmutable.last_confirmed_orig_trx_block_time_slot) is false");
 
       _origtrxs.erase( _origtrxs.find(it->id) );
+      update_origtrxs_summary( peerchain_name, 1 );
 
       auto _rmdunrbs2 = rmdunrbs_table2( _self, _self.value );
       _rmdunrbs2.emplace( _self, [&]( auto& r ) {
@@ -1257,7 +1658,9 @@ namespace eosio {
 
       for ( const auto& trx_id : trxs ){
          auto idx = _origtrxs.get_index<"trxid"_n>();
-         const auto& record = idx.get( fixed_bytes<32>(trx_id), "trx_id not found");
+         auto it = find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.trx_id; } );
+         eosio::check( it != idx.end(), "trx_id not found");
+         const auto& record = *it;
          transfer_action_info action_info = record.action;
 
          bool ibc_withdraw = false;
@@ -1278,7 +1681,7 @@ namespace eosio {
             if( action_info.from != _self ) {
                string memo = "rollback transaction: " + checksum256_to_string(trx_id);
                transfer_action_type action_data{ _self, action_info.from, action_info.quantity, memo };
-               action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ).send();
+               send_inline( action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ) );
             }
          } else { // rollback withdraw
             const auto& st = get_currency_stats( action_info.quantity.symbol.code() );
@@ -1287,18 +1690,19 @@ namespace eosio {
                r.max_supply += action_info.quantity;
                r.total_withdraw -= action_info.quantity;
                r.total_withdraw_times -= 1;
+               r.stats2_dirty.emplace( true );
             });
 
             if( action_info.from != _self ) {
                string memo = "rollback transaction: " + checksum256_to_string(trx_id);
                transfer_action_type action_data{ _self, action_info.from, action_info.quantity, memo };
-               action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ).send();
+               send_inline( action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ) );
             }
-
-            update_stats2( st.supply.symbol.code() );
          }
+         emit_event( "evrollback"_n, peerchain_name, trx_id, action_info.from != _self ? action_info.quantity : asset(0, action_info.quantity.symbol) );
          _origtrxs.erase( record );
       }
+      update_origtrxs_summary( peerchain_name, trxs.size() );
    }
 
    void token::fcrmorigtrx( name peerchain_name, const std::vector<transaction_id_type> trxs ){
@@ -1308,9 +1712,12 @@ namespace eosio {
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       for ( const auto& trx_id : trxs ){
          auto idx = _origtrxs.get_index<"trxid"_n>();
-         const auto& record = idx.get( fixed_bytes<32>(trx_id), "trx_id not found");
+         auto it = find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.trx_id; } );
+         eosio::check( it != idx.end(), "trx_id not found");
+         const auto& record = *it;
          _origtrxs.erase( record );
       }
+      update_origtrxs_summary( peerchain_name, trxs.size() );
    }
 
    void token::lockall() {
@@ -1403,11 +1810,15 @@ namespace eosio {
 
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       auto _cashtrxs = cashtrxs_table( _self, peerchain_name.value );
+      auto _cashblks = cashblks_table( _self, peerchain_name.value );
       auto _rmdunrbs = rmdunrbs_table( _self, peerchain_name.value );
+      auto _chainlanes = chainlanes_table( _self, peerchain_name.value );
 
       eosio::check( _origtrxs.begin() != _origtrxs.end() ||
                     _cashtrxs.begin() != _cashtrxs.end() ||
-                    _rmdunrbs.begin() != _rmdunrbs.end(), "already empty");
+                    _cashblks.begin() != _cashblks.end() ||
+                    _rmdunrbs.begin() != _rmdunrbs.end() ||
+                    _chainlanes.begin() != _chainlanes.end(), "already empty");
 
       uint32_t count = 0, max_delete_per_time = 200;
       while ( _origtrxs.begin() != _origtrxs.end() && count++ < max_delete_per_time ){
@@ -1416,9 +1827,15 @@ namespace eosio {
       while ( _cashtrxs.begin() != _cashtrxs.end() && count++ < max_delete_per_time ){
          _cashtrxs.erase(_cashtrxs.begin());
       }
+      while ( _cashblks.begin() != _cashblks.end() && count++ < max_delete_per_time ){
+         _cashblks.erase(_cashblks.begin());
+      }
       while ( _rmdunrbs.begin() != _rmdunrbs.end() && count++ < max_delete_per_time ){
          _rmdunrbs.erase(_rmdunrbs.begin());
       }
+      while ( _chainlanes.begin() != _chainlanes.end() && count++ < max_delete_per_time ){
+         _chainlanes.erase(_chainlanes.begin());
+      }
 
       auto itr = _peerchainm.find( peerchain_name.value );
       if ( itr != _peerchainm.end() ){
@@ -1428,15 +1845,21 @@ namespace eosio {
             r.current_block_time_slot                 = 0;
             r.current_block_trxs                      = 0;
             r.origtrxs_tb_next_id                     = 1;
+            r.block_trxs.emplace( token_bucket{} );
+            r.pending_origtrxs.emplace( 0 );
+            r.oldest_origtrx_id.emplace( 0 );
+            r.oldest_origtrx_slot.emplace( 0 );
          });
       }
 
       if( _origtrxs.begin() == _origtrxs.end() &&
           _cashtrxs.begin() == _cashtrxs.end() &&
-          _rmdunrbs.begin() == _rmdunrbs.end() ){
-         print( "force initialization complete" );
+          _cashblks.begin() == _cashblks.end() &&
+          _rmdunrbs.begin() == _rmdunrbs.end() &&
+          _chainlanes.begin() == _chainlanes.end() ){
+         IBC_LOG_INFO( "force initialization complete" );
       } else {
-         print( "force initialization not complete" );
+         IBC_LOG_INFO( "force initialization not complete" );
       }
    }
 
@@ -1461,52 +1884,199 @@ namespace eosio {
          r.trx_id = trx_id;
          r.action = action;
       });
+      emit_event( "evorigtrx"_n, peerchain_name, pchm.origtrxs_tb_next_id, trx_id, action.quantity );
 
       _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
+         r.fill_extensions();
+         auto pending = r.pending_origtrxs.value_or( 0 );
+         if ( pending == 0 ){
+            r.oldest_origtrx_id.emplace( r.origtrxs_tb_next_id );
+            r.oldest_origtrx_slot.emplace( get_block_time_slot() );
+         }
          r.origtrxs_tb_next_id += 1;
+         r.pending_origtrxs.emplace( pending + 1 );
       });
    }
 
    transfer_action_info token::get_orignal_action_by_trx_id( name peerchain_name, transaction_id_type trx_id ) {
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       auto idx = _origtrxs.get_index<"trxid"_n>();
-      auto itr = idx.find( fixed_bytes<32>(trx_id) );
+      auto itr = find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.trx_id; } );
       eosio::check( itr != idx.end(), "orig_trx_id not exist");
       return itr->action;
    }
 
-   void token::erase_record_in_origtrxs_tb_by_trx_id_for_confirmed( name peerchain_name, transaction_id_type  trx_id ){
+   asset token::erase_record_in_origtrxs_tb_by_trx_id_for_confirmed( name peerchain_name, transaction_id_type  trx_id ){
       auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
       auto idx = _origtrxs.get_index<"trxid"_n>();
-      auto it = idx.find( fixed_bytes<32>(trx_id) );
+      auto it = find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.trx_id; } );
       eosio::check( it != idx.end(), "trx_id not exit in origtrxs table");
 
-      auto& pchm = _peerchainm.get( peerchain_name.value );
-      _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
-         r.last_confirmed_orig_trx_block_time_slot = it->block_time_slot;
+      auto lane = get_lane( peerchain_name, it->action.quantity.symbol.code() ).lane;
+      set_lane_last_confirmed_slot( peerchain_name, lane, it->block_time_slot );
+
+      asset total( 0, it->action.quantity.symbol );
+      uint64_t count = 0;
+      auto prefix = trx_id_prefix( trx_id );
+      while ( it != idx.end() && it->by_trx_id() == prefix ){
+         if ( it->trx_id == trx_id ){
+            total += it->action.quantity;
+            it = idx.erase(it);
+            ++count;
+         } else {
+            ++it;
+         }
+      }
+      update_origtrxs_summary( peerchain_name, count );
+      return total;
+   }
+
+   // ---- ibc lanes related methods  ----
+   token::lane_info token::get_lane( name peerchain_name, symbol_code sym_code ){
+      lane_info info;
+      auto cfg = _lanecfg.find( peerchain_name.value );
+      if ( cfg == _lanecfg.end() ){
+         return info;
+      }
+      info.orig_trx_block_num_floor = cfg->orig_trx_block_num_floor;
+
+      auto _symlanes = symlanes_table( _self, peerchain_name.value );
+      auto itr = _symlanes.find( sym_code.raw() );
+      if ( itr != _symlanes.end() ){
+         info.lane = itr->lane;
+      } else if ( cfg->buckets != 0 ){
+         info.lane = sym_code.raw() % cfg->buckets;
+      }
+      return info;
+   }
+
+   uint64_t token::get_lane_cash_seq_num( name peerchain_name, uint32_t lane ){
+      if ( lane == 0 ){
+         return _peerchainm.get( peerchain_name.value, "peerchain not found").cash_seq_num;
+      }
+      auto _chainlanes = chainlanes_table( _self, peerchain_name.value );
+      auto itr = _chainlanes.find( lane );
+      return itr != _chainlanes.end() ? itr->cash_seq_num : 0;
+   }
+
+   void token::increase_lane_cash_seq_num( name peerchain_name, uint32_t lane ){
+      if ( lane == 0 ){
+         const auto& pchm = _peerchainm.get( peerchain_name.value, "peerchain not found");
+         _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
+            r.cash_seq_num += 1;
+         });
+         return;
+      }
+      auto _chainlanes = chainlanes_table( _self, peerchain_name.value );
+      auto itr = _chainlanes.find( lane );
+      if ( itr == _chainlanes.end() ){
+         _chainlanes.emplace( _self, [&]( auto& r ) {
+            r.lane = lane;
+            r.cash_seq_num = 1;
+         });
+      } else {
+         _chainlanes.modify( itr, same_payer, [&]( auto& r ) {
+            r.cash_seq_num += 1;
+         });
+      }
+   }
+
+   uint32_t token::get_lane_last_confirmed_slot( name peerchain_name, uint32_t lane ){
+      if ( lane == 0 ){
+         return _peerchainm.get( peerchain_name.value, "peerchain not found").last_confirmed_orig_trx_block_time_slot;
+      }
+      auto _chainlanes = chainlanes_table( _self, peerchain_name.value );
+      auto itr = _chainlanes.find( lane );
+      return itr != _chainlanes.end() ? itr->last_confirmed_orig_trx_block_time_slot : 0;
+   }
+
+   void token::set_lane_last_confirmed_slot( name peerchain_name, uint32_t lane, uint32_t slot ){
+      if ( lane == 0 ){
+         const auto& pchm = _peerchainm.get( peerchain_name.value, "peerchain not found");
+         _peerchainm.modify( pchm, same_payer, [&]( auto& r ) {
+            r.last_confirmed_orig_trx_block_time_slot = slot;
+         });
+         return;
+      }
+      auto _chainlanes = chainlanes_table( _self, peerchain_name.value );
+      auto itr = _chainlanes.find( lane );
+      if ( itr == _chainlanes.end() ){
+         _chainlanes.emplace( _self, [&]( auto& r ) {
+            r.lane = lane;
+            r.last_confirmed_orig_trx_block_time_slot = slot;
+         });
+      } else {
+         _chainlanes.modify( itr, same_payer, [&]( auto& r ) {
+            r.last_confirmed_orig_trx_block_time_slot = slot;
+         });
+      }
+   }
+
+   void token::check_lanes_changeable( name peerchain_name ){
+      const auto& pch = _peerchains.get( peerchain_name.value, "peerchain not registered");
+      eosio::check( ! pch.active, "peerchain must be inactive when changing lanes");
+
+      auto _origtrxs = origtrxs_table( _self, peerchain_name.value );
+      eosio::check( _origtrxs.begin() == _origtrxs.end(), "origtrxs table of this peerchain must be empty when changing lanes");
+   }
+
+   /**
+    * symbols may move between lanes, so cash must only accept original transactions in blocks
+    * above every block already cashed from this peerchain, whichever lane it was cashed in.
+    */
+   void token::update_lanes_floor( name peerchain_name ){
+      auto _cashblks = cashblks_table( _self, peerchain_name.value );
+
+      uint64_t floor = 0;
+      auto it = _cashblks.begin();
+      while ( it != _cashblks.end() ){
+         uint32_t lane = it->key >> lane_key_shift;
+         auto next = _cashblks.lower_bound( lane_key( lane + 1, 0 ) );
+         auto last = next; --last;
+         floor = std::max( floor, last->orig_trx_block_num() );
+         it = next;
+      }
+
+      const auto& cfg = _lanecfg.get( peerchain_name.value );
+      _lanecfg.modify( cfg, same_payer, [&]( auto& r ) {
+         r.orig_trx_block_num_floor = std::max( r.orig_trx_block_num_floor, floor );
       });
+   }
 
-      idx.erase(it);
+   // ---- cash_block_info related methods  ----
+   void token::cashblks_emplace( name peerchain_name, uint32_t lane, uint32_t orig_trx_block_num, const cash_trx_entry& entry ) {
+      auto _cashblks = cashblks_table( _self, peerchain_name.value );
+      auto itr = _cashblks.find( lane_key( lane, orig_trx_block_num ) );
+      if ( itr == _cashblks.end() ){
+         _cashblks.emplace( _self, [&]( auto& r ) {
+            r.key = lane_key( lane, orig_trx_block_num );
+            r.trxs.push_back( entry );
+         });
+      } else {
+         _cashblks.modify( itr, same_payer, [&]( auto& r ) {
+            r.trxs.push_back( entry );
+         });
+      }
    }
 
-   // ---- cash_trx_info related methods  ----
-   void token::trim_cashtrxs_table_or_not( name peerchain_name ) {
-      auto _cashtrxs = cashtrxs_table( _self, peerchain_name.value );
-      
-      uint32_t total = 0;
-      if ( _cashtrxs.begin() == _cashtrxs.end()){
+   void token::trim_cashblks_table_or_not( name peerchain_name, uint32_t lane ) {
+      auto _cashblks = cashblks_table( _self, peerchain_name.value );
+
+      auto first = _cashblks.lower_bound( lane_key( lane, 0 ) );
+      auto end = _cashblks.lower_bound( lane_key( lane + 1, 0 ) );
+      if ( first == end ){
          return;
       }
-      
-      total = (--_cashtrxs.end())->seq_num - _cashtrxs.begin()->seq_num;
+      auto last = end; --last;
+
+      uint64_t total = last->trxs.back().seq_num - first->trxs.front().seq_num;
       auto pch = _peerchains.get( peerchain_name.value );
       if ( total > pch.cache_cashtrxs_table_records ){
-         auto last_orig_trx_block_num = _cashtrxs.rbegin()->orig_trx_block_num;
-         int i = 10; // erase 10 records per time
-         while ( i-- > 0 ){
-            auto first_orig_trx_block_num = _cashtrxs.begin()->orig_trx_block_num;
-            if ( last_orig_trx_block_num - first_orig_trx_block_num > 1 ) { // very importand
-               _cashtrxs.erase( _cashtrxs.begin() );
+         auto last_orig_trx_block_num = last->orig_trx_block_num();
+         int i = 10; // erase 10 blocks per time
+         while ( i-- > 0 && first != last ){
+            if ( last_orig_trx_block_num - first->orig_trx_block_num() > 1 ) { // very importand
+               first = _cashblks.erase( first );
             } else {
                break;
             }
@@ -1514,28 +2084,26 @@ namespace eosio {
       }
    }
 
-   uint64_t token::get_cashtrxs_tb_max_seq_num( name peerchain_name ) {
-      auto _cashtrxs = cashtrxs_table( _self, peerchain_name.value );
-      if ( _cashtrxs.begin() != _cashtrxs.end() ){
-         return _cashtrxs.rbegin()->seq_num;
-      }
-      return 0;
-   }
-
-   uint64_t token::get_cashtrxs_tb_min_orig_trx_block_num( name peerchain_name ) {
-      auto _cashtrxs = cashtrxs_table( _self, peerchain_name.value );
-      auto idx = _cashtrxs.get_index<"blocknum"_n>();
-      if ( idx.begin() != idx.end() ){
-         return idx.begin()->orig_trx_block_num;
+   uint64_t token::get_cashblks_tb_max_seq_num( name peerchain_name, uint32_t lane ) {
+      auto _cashblks = cashblks_table( _self, peerchain_name.value );
+      auto it = _cashblks.lower_bound( lane_key( lane + 1, 0 ) );
+      if ( it != _cashblks.begin() ){
+         --it;
+         if ( it->key >> lane_key_shift == lane ){
+            return it->trxs.back().seq_num;
+         }
       }
       return 0;
    }
 
-   uint64_t token::get_cashtrxs_tb_max_orig_trx_block_num( name peerchain_name ) {
-      auto _cashtrxs = cashtrxs_table( _self, peerchain_name.value );
-      auto idx = _cashtrxs.get_index<"blocknum"_n>();
-      if ( idx.begin() != idx.end() ){
-         return idx.rbegin()->orig_trx_block_num;
+   uint64_t token::get_cashblks_tb_max_orig_trx_block_num( name peerchain_name, uint32_t lane ) {
+      auto _cashblks = cashblks_table( _self, peerchain_name.value );
+      auto it = _cashblks.lower_bound( lane_key( lane + 1, 0 ) );
+      if ( it != _cashblks.begin() ){
+         --it;
+         if ( it->key >> lane_key_shift == lane ){
+            return it->orig_trx_block_num();
+         }
       }
       return 0;
    }
@@ -1543,14 +2111,48 @@ namespace eosio {
    /**
     * This is a Very Importand Function, Used to Avoid Replay Attack
     */
-   bool token::is_orig_trx_id_exist_in_cashtrxs_tb( name peerchain_name, transaction_id_type orig_trx_id ) {
-      auto _cashtrxs = cashtrxs_table( _self, peerchain_name.value );
-      auto idx = _cashtrxs.get_index<"trxid"_n>();
-      auto it = idx.find( fixed_bytes<32>(orig_trx_id) );
-      if ( it == idx.end() ) {
+   bool token::is_orig_trx_id_exist_in_cashblks_tb( name peerchain_name, uint32_t lane, uint32_t orig_trx_block_num, const transaction_id_type& orig_trx_id ) {
+      auto _cashblks = cashblks_table( _self, peerchain_name.value );
+      auto itr = _cashblks.find( lane_key( lane, orig_trx_block_num ) );
+      if ( itr == _cashblks.end() ) {
          return false;
       }
-      return true;
+      for ( const auto& entry : itr->trxs ){
+         if ( entry.orig_trx_id == orig_trx_id ) {
+            return true;
+         }
+      }
+      return false;
+   }
+
+   void token::mvcashtrxs( name peerchain_name, uint32_t max_rows ){
+      check_admin_auth();
+
+      auto _cashtrxs = cashtrxs_table( _self, peerchain_name.value );
+      eosio::check( _cashtrxs.begin() != _cashtrxs.end(), "nothing to move");
+
+      uint32_t count = 0;
+      while ( _cashtrxs.begin() != _cashtrxs.end() && count++ < max_rows ){
+         auto itr = _cashtrxs.begin();
+         cashblks_emplace( peerchain_name, itr->seq_num >> lane_key_shift, itr->orig_trx_block_num,
+                           cash_trx_entry{ itr->seq_num & lane_seq_mask, uint32_t(itr->block_time_slot), itr->trx_id, itr->orig_trx_id } );
+         _cashtrxs.erase( itr );
+      }
+   }
+
+   void token::syncstats( symbol_code from_symcode, uint32_t max_rows ){
+      eosio::check( max_rows > 0, "max_rows must be greater than zero" );
+
+      auto itr = _stats.lower_bound( from_symcode.raw() );
+      for ( uint32_t count = 0; itr != _stats.end() && count < max_rows; ++itr, ++count ){
+         if ( itr->stats2_dirty.value_or( false ) ){
+            update_stats2( itr->supply.symbol.code() );
+            _stats.modify( itr, same_payer, [&]( auto& r ) { r.stats2_dirty.emplace( false ); });
+         }
+      }
+      if ( itr != _stats.end() ){
+         IBC_LOG_INFO( "syncstats stopped before %", itr->supply.symbol.code() );
+      }
    }
 
    void token::update_stats2( symbol_code sym_code ){
@@ -1583,16 +2185,15 @@ namespace eosio {
                                 const name&                     from_account,
                                 const transaction_id_type&      orig_trx_id,
                                 const asset&                    quantity,
-                                const string&                   memo,
+                                std::string_view                memo,
                                 bool                            from_free_account){
 
-      /// parse memo string
-      string tmp_memo = memo;
-      trim( tmp_memo );
-      eosio::check( tmp_memo.find(">>") == 0, error_info.c_str() );
-      tmp_memo = tmp_memo.substr(2);
-      trim( tmp_memo );
-      auto memo_info = get_memo_info( tmp_memo );
+      /// parse memo string, only leading spaces are skipped, because the dest memo may be a binary memo
+      memo.remove_prefix( std::min( memo.find_first_not_of(' '), memo.size() ) );
+      eosio::check( memo.substr(0,2) == ">>", error_info.c_str() );
+      memo.remove_prefix( 2 );
+      memo.remove_prefix( std::min( memo.find_first_not_of(' '), memo.size() ) );
+      auto memo_info = get_memo_info( memo );
 
       /// assert ...
       eosio::check(memo_info.receiver != name(),"receiver not provide");
@@ -1624,113 +2225,176 @@ namespace eosio {
          eosio::check( mini_to_quantity >= ptr->min_once_withdraw, "mini_to_quantity >= ptr->min_once_withdraw assert failed" );
       }
 
+      /// check max unfinished hub trxs of the dest chain
+      hubqueues_table _hubqueues( _self, _self.value );
+      auto queue = _hubqueues.find( memo_info.peerchain.value );
+      if ( queue == _hubqueues.end() ){
+         queue = _hubqueues.emplace( _self, [&]( auto& r ) { r.to_chain = memo_info.peerchain; });
+      }
+      uint64_t max_unfinished = queue->max_unfinished_trxs != 0 ? queue->max_unfinished_trxs : max_hub_unfinished_trxs;
+      eosio::check( queue->unfinished_trxs < max_unfinished, "to much unfinished hub trxs to the dest chain");
+      uint64_t p_id = queue->next_id;
+      _hubqueues.modify( queue, same_payer, [&]( auto& r ) {
+         r.next_id         += 1;
+         r.unfinished_trxs += 1;
+      });
+
       /// record to hub table
-      auto _hubtrxs = hubtrxs_table( _self, _self.value );
-      auto p_id = _hubtrxs.available_primary_key();
-      p_id = p_id == 0 ? 1 : p_id;
+      auto memo_hash = ibc_sha256( memo_info.notes.data(), memo_info.notes.size() );
+      auto _hubtrxs = hubtrxs_table( _self, memo_info.peerchain.value );
       _hubtrxs.emplace( _self, [&]( auto& r ) {
          r.id                 = p_id; /// can not use cash_seq_num,
-         r.cash_time_slot     = get_block_time_slot();
          r.from_chain         = from_chain;
          r.from_account       = from_account;
-         r.from_quantity      = quantity;
-         r.mini_to_quantity   = mini_to_quantity;
-         r.orig_trx_id        = orig_trx_id;
-         r.to_chain           = memo_info.peerchain ;
          r.to_account         = memo_info.receiver;
-         r.orig_pure_memo     = memo_info.notes;
-         r.to_quantity        = asset{0,quantity.symbol};
          r.fee_receiver       = name();
+         r.sym                = quantity.symbol;
+         r.from_amount        = quantity.amount;
+         r.mini_to_amount     = mini_to_quantity.amount;
+         r.to_amount          = 0;
+         r.orig_trx_id        = orig_trx_id;
          r.hub_trx_id         = checksum256();
+         r.memo_hash          = memo_hash;
+         r.cash_time_slot     = get_block_time_slot();
          r.hub_trx_time_slot  = 0;
-         r.forward_times      = 0;
-         r.backward_times     = 0;
+         r.set_status( 0, 0, hub_trx_cashed );
       });
-
-      /// check max unfinished hub trxs
-      eosio::check(_hubgs.unfinished_trxs < max_hub_unfinished_trxs, "to much unfinished hub trxs");
-      _hubgs.unfinished_trxs += 1;
+      emit_event( "evhubtrx"_n, memo_info.peerchain, p_id, orig_trx_id, memo_hash, string( memo_info.notes ) );
    }
 
    const string error_info2 = "for the transfer action from the hub accout,it's memo string format "
                              "must be: <account>@<dest_chain_name> orig_trx_id=<trx_id> [worker=account] [optional user defined string]";
 
-   void token::ibc_transfer_from_hub( const name& to, const asset& quantity, const string& memo  ){
+   void token::ibc_transfer_from_hub( const name& to, const asset& quantity, const memo_info_type& memo_info ){
       /// --- check to ---
       eosio::check( to == _self, "the to account of hub transfer must be _self");
 
-      /// --- check memo string ---
-      /// 1. parse memo string
-      string tmp_memo = memo;
-      auto memo_info = get_memo_info( tmp_memo );
-
-      /// 2. get orig_trx_id
-      string value_str = get_value_str_by_key_str( memo, "orig_trx_id");
-      eosio::check( value_str.size() != 0, error_info2.c_str());
-      eosio::check( value_str.size() == 64, "orig_trx_id value not valid");
-      checksum256 orig_trx_id = string_to_checksum256( value_str );
+      /// --- check memo string, which was parsed by transfer() ---
+      /// 1. get orig_trx_id
+      eosio::check( memo_info.orig_trx_id.size() != 0, error_info2.c_str());
+      eosio::check( memo_info.binary || memo_info.orig_trx_id.size() == 64, "orig_trx_id value not valid");
+      checksum256 orig_trx_id = memo_value_to_checksum256( memo_info, memo_info.orig_trx_id );
 
-      /// 3. get hubtrxs table recored
-      auto _hubtrxs = hubtrxs_table( _self, _self.value );
+      /// 2. get hubtrxs table recored
+      name scope = get_hub_trx_scope( orig_trx_id, false, memo_info.peerchain );
+      eosio::check( scope != name(), "original transaction not found with the specified id");
+      auto _hubtrxs = hubtrxs_table( _self, scope.value );
       auto idx = _hubtrxs.get_index<"origtrxid"_n>();
-      const auto& hub_trx_p = idx.find(fixed_bytes<32>(orig_trx_id.hash));
+      const auto& hub_trx_p = find_by_trx_id( idx, orig_trx_id, []( const auto& r ){ return r.orig_trx_id; } );
       eosio::check( hub_trx_p != idx.end(), "original transaction not found with the specified id");
 
-      /// 4. check ...
-      eosio::check( std::memcmp(hub_trx_p->hub_trx_id.hash, checksum256().hash, 32) == 0 &&
-                    hub_trx_p->hub_trx_time_slot == 0, "hub trx can not double spend!");
+      /// 3. check ...
+      eosio::check( hub_trx_p->state() == hub_trx_cashed, "hub trx can not double spend!");
 
-      if ( memo_info.peerchain == hub_trx_p->to_chain ) {
+      uint8_t forward_times = hub_trx_p->forward_times();
+      uint8_t backward_times = hub_trx_p->backward_times();
+      if ( memo_info.peerchain == scope ) {
          eosio::check( memo_info.receiver == hub_trx_p->to_account, "hub trx must transfer to it's dest account");
-         _hubtrxs.modify( *hub_trx_p, same_payer, [&]( auto& r ) { r.forward_times += 1; });
+         forward_times += 1;
       } else if ( memo_info.peerchain == hub_trx_p->from_chain ) {
          eosio::check( memo_info.receiver == hub_trx_p->from_account, "hub trx must transfer to it's original account");
          auto slot = get_block_time_slot();
          eosio::check( slot - hub_trx_p->cash_time_slot > 240, "you can't transfer hub trx back to it's original chain within two minutes");
-         _hubtrxs.modify( *hub_trx_p, same_payer, [&]( auto& r ) { r.backward_times += 1; });
+         backward_times += 1;
       } else {
          eosio::check(false, "hub trx must transfer to it's dest chain or original chain");
       }
 
       /// --- check quantity ---
-      eosio::check(quantity.symbol == hub_trx_p->from_quantity.symbol, "quantity.symbol == hub_trx_p->from_quantity.symbol assert failed");
-      eosio::check(hub_trx_p->from_quantity >= quantity && quantity >= hub_trx_p->mini_to_quantity, "quantity must in range [from_quantity,mini_to_quantity]");
+      eosio::check(quantity.symbol == hub_trx_p->sym, "quantity.symbol == hub_trx_p->sym assert failed");
+      eosio::check(hub_trx_p->from_amount >= quantity.amount && quantity.amount >= hub_trx_p->mini_to_amount, "quantity must in range [from_quantity,mini_to_quantity]");
 
       /// transfer fee to receiver
-      string worker = get_value_str_by_key_str( memo, "worker");
-      name receiver = name();
-      if ( worker.size() ){
-         receiver = name(worker);
+      name receiver = memo_value_to_name( memo_info, memo_info.worker );
+      if ( receiver != name() ){
          eosio::check(is_account(receiver), "worker account does not exist");
       }
 
       /// recored to hubtrxs table
       _hubtrxs.modify( *hub_trx_p, same_payer, [&]( auto& r ) {
-         r.to_quantity        = quantity;
+         r.to_amount          = quantity.amount;
          r.fee_receiver       = receiver;
          r.hub_trx_id         = get_trx_id();
          r.hub_trx_time_slot  = get_block_time_slot();
+         r.set_status( forward_times, backward_times, hub_trx_transferred );
       });
    }
 
-   void token::rollback_hub_trx( const transaction_id_type& hub_trx_id, asset quantity ){
-      auto _hubtrxs = hubtrxs_table( _self, _self.value );
+   void token::cashfwd( const uint64_t&                        seq_num,
+                        const name&                            from_chain,
+                        const transaction_id_type&             orig_trx_id,
+                        const std::vector<char>&               orig_trx_packed_trx_receipt,
+                        const std::vector<checksum256>&        orig_trx_merkle_path,
+                        const uint32_t&                        orig_trx_block_num,
+                        const std::vector<char>&               orig_trx_block_header_data,
+                        const std::vector<checksum256>&        orig_trx_block_id_merkle_path,
+                        const uint32_t&                        anchor_block_num,
+                        const name&                            to,
+                        const asset&                           quantity,
+                        const string&                          memo,
+                        const name&                            relay,
+                        const transfer_action_type&            forward ){
+      eosio::check( _hubgs.is_open && to == _hubgs.hub_account, "the to account of cashfwd must be the hub account");
+      eosio::check( forward.from == _hubgs.hub_account && forward.to == _self, "forward must be a transfer from the hub account to _self");
+
+      auto info = get_memo_info( forward.memo );
+      eosio::check( info.orig_trx_id.size() != 0 && ( info.binary || info.orig_trx_id.size() == 64 ), error_info2.c_str());
+      eosio::check( memo_value_to_checksum256( info, info.orig_trx_id ) == orig_trx_id, "forward must spend the hub trx of this cash");
+
+      cash( seq_num, from_chain, orig_trx_id, orig_trx_packed_trx_receipt, orig_trx_merkle_path, orig_trx_block_num,
+            orig_trx_block_header_data, orig_trx_block_id_merkle_path, anchor_block_num, to, quantity, memo, relay );
+
+      /// the forward must carry the hub trx just recorded to its dest account, with the quantity fixed by cash
+      auto _hubtrxs = hubtrxs_table( _self, info.peerchain.value );
+      auto idx = _hubtrxs.get_index<"origtrxid"_n>();
+      const auto& hub_trx_p = find_by_trx_id( idx, orig_trx_id, []( const auto& r ){ return r.orig_trx_id; } );
+      eosio::check( hub_trx_p != idx.end(), "forward must transfer to the dest chain of the hub trx");
+      eosio::check( info.receiver == hub_trx_p->to_account, "forward must transfer to the dest account of the hub trx");
+      eosio::check( forward.quantity == hub_trx_p->mini_to_quantity(), "forward quantity must equal to mini_to_quantity of the hub trx");
+
+      /// the forward leg, records the origtrx to the dest chain and marks the hub trx as forwarded
+      _hub_forwarding = true;
+      transfer( forward.from, forward.to, forward.quantity, forward.memo );
+      _hub_forwarding = false;
+   }
+
+   // a confirmed cashfwd must have transferred its hub trx to the confirming dest chain with the recorded quantity
+   void token::check_hub_forward_confirmed( name peerchain_name, const transaction_id_type& hub_trx_id, const transfer_action_type& forward ){
+      name scope = get_hub_trx_scope( hub_trx_id, true, peerchain_name );
+      if ( scope == name() ){
+         return;
+      }
+      eosio::check( scope == peerchain_name, "forward of cashfwd must transfer to the dest chain of the hub trx");
+      auto _hubtrxs = hubtrxs_table( _self, scope.value );
+      auto idx = _hubtrxs.get_index<"hubtrxid"_n>();
+      const auto& hub_trx_p = find_by_trx_id( idx, hub_trx_id, []( const auto& r ){ return r.hub_trx_id; } );
+      eosio::check( get_memo_info( forward.memo ).receiver == hub_trx_p->to_account, "forward of cashfwd must transfer to the dest account of the hub trx");
+      eosio::check( forward.quantity == hub_trx_p->to_quantity(), "forward quantity of cashfwd must equal to to_quantity of the hub trx");
+   }
+
+   void token::rollback_hub_trx( name peerchain_name, const transaction_id_type& hub_trx_id, asset quantity ){
+      name scope = get_hub_trx_scope( hub_trx_id, true, peerchain_name );
+      if ( scope == name() ){
+         return;
+      }
+      auto _hubtrxs = hubtrxs_table( _self, scope.value );
       auto idx = _hubtrxs.get_index<"hubtrxid"_n>();
-      const auto& hub_trx_p = idx.find(fixed_bytes<32>(hub_trx_id.hash));
+      const auto& hub_trx_p = find_by_trx_id( idx, hub_trx_id, []( const auto& r ){ return r.hub_trx_id; } );
       if( hub_trx_p != idx.end()){
-         auto diff = hub_trx_p->from_quantity - hub_trx_p->mini_to_quantity;
-         auto mini_to_quantity = quantity;
-         if ( quantity.amount > diff.amount ){
-            mini_to_quantity = quantity - diff;
+         auto diff = hub_trx_p->from_amount - hub_trx_p->mini_to_amount;
+         auto mini_to_amount = quantity.amount;
+         if ( quantity.amount > diff ){
+            mini_to_amount = quantity.amount - diff;
          }
 
          _hubtrxs.modify( *hub_trx_p, same_payer, [&]( auto& r ) {
-            r.from_quantity      = quantity;
-            r.mini_to_quantity   = mini_to_quantity;
-            r.to_quantity.amount = 0;
+            r.from_amount        = quantity.amount;
+            r.mini_to_amount     = mini_to_amount;
+            r.to_amount          = 0;
             r.fee_receiver       = name();
             r.hub_trx_id         = checksum256();
             r.hub_trx_time_slot  = 0;
+            r.set_status( r.forward_times(), r.backward_times(), hub_trx_cashed );
          });
       }
    }
@@ -1738,95 +2402,118 @@ namespace eosio {
    void token::rbkdiehubtrx( const transaction_id_type& hub_trx_id ){
       check_admin_auth();
 
-      auto _hubtrxs = hubtrxs_table( _self, _self.value );
+      name scope = get_hub_trx_scope( hub_trx_id, true, name() );
+      eosio::check( scope != name(), "hub_trx_id not exist!");
+      auto _hubtrxs = hubtrxs_table( _self, scope.value );
       auto idx = _hubtrxs.get_index<"hubtrxid"_n>();
-      const auto& hub_trx_p = idx.find(fixed_bytes<32>(hub_trx_id.hash));
+      const auto& hub_trx_p = find_by_trx_id( idx, hub_trx_id, []( const auto& r ){ return r.hub_trx_id; } );
       eosio::check(hub_trx_p != idx.end(), "hub_trx_id not exist!");
 
-      auto _origtrxs = origtrxs_table( _self, hub_trx_p->to_chain.value );
+      auto _origtrxs = origtrxs_table( _self, scope.value );
       auto idx2 = _origtrxs.get_index<"trxid"_n>();
-      auto it = idx2.find( fixed_bytes<32>(hub_trx_id.hash) );
+      auto it = find_by_trx_id( idx2, hub_trx_id, []( const auto& r ){ return r.trx_id; } );
       eosio::check( it == idx2.end(), "original trx still exist!");
 
+      const auto to_quantity = hub_trx_p->to_quantity();
       string memo = "rollback hub transaction: " + checksum256_to_string(hub_trx_id);
 
       bool ibc_withdraw = false;
-      auto sym_code_raw = hub_trx_p->to_quantity.symbol.code().raw();
+      auto sym_code_raw = to_quantity.symbol.code().raw();
       auto itr = _stats.find( sym_code_raw );
-      if ( itr != _stats.end() && hub_trx_p->to_chain == itr->peerchain_name ){
+      if ( itr != _stats.end() && scope == itr->peerchain_name ){
          ibc_withdraw = true;
       }
 
       if ( ! ibc_withdraw ){  // rollback ibc transfer
-         const auto& acpt = get_currency_accept(hub_trx_p->to_quantity.symbol.code());
+         const auto& acpt = get_currency_accept(to_quantity.symbol.code());
          _accepts.modify( acpt, same_payer, [&]( auto& r ) {
-            r.accept -= hub_trx_p->to_quantity;
-            r.total_transfer -= hub_trx_p->to_quantity;
+            r.accept -= to_quantity;
+            r.total_transfer -= to_quantity;
             r.total_transfer_times -= 1;
          });
 
          if ( acpt.original_contract == _self ){
-            transfer_action_type action_data{ _self, _hubgs.hub_account, hub_trx_p->to_quantity, memo };
-            action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ).send();
+            transfer_action_type action_data{ _self, _hubgs.hub_account, to_quantity, memo };
+            send_inline( action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ) );
          }
       } else { // rollback ibc withdraw
-         const auto& st = get_currency_stats( hub_trx_p->to_quantity.symbol.code() );
+         const auto& st = get_currency_stats( to_quantity.symbol.code() );
          _stats.modify( st, same_payer, [&]( auto& r ) {
-            r.supply += hub_trx_p->to_quantity;
-            r.max_supply += hub_trx_p->to_quantity;
-            r.total_withdraw -= hub_trx_p->to_quantity;
+            r.supply += to_quantity;
+            r.max_supply += to_quantity;
+            r.total_withdraw -= to_quantity;
             r.total_withdraw_times -= 1;
+            r.stats2_dirty.emplace( true );
          });
 
-         transfer_action_type action_data{ _self, _hubgs.hub_account, hub_trx_p->to_quantity, memo };
-         action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ).send();
-
-         update_stats2( st.supply.symbol.code() );
+         transfer_action_type action_data{ _self, _hubgs.hub_account, to_quantity, memo };
+         send_inline( action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ) );
       }
 
       _hubtrxs.modify( *hub_trx_p, same_payer, [&]( auto& r ) {
-         r.to_quantity.amount = 0;
+         r.to_amount          = 0;
          r.fee_receiver       = name();
          r.hub_trx_id         = checksum256();
          r.hub_trx_time_slot  = 0;
+         r.set_status( r.forward_times(), r.backward_times(), hub_trx_cashed );
       });
    }
 
-   void token::delete_by_hub_trx_id( const transaction_id_type& hub_trx_id ){
-      auto _hubtrxs = hubtrxs_table( _self, _self.value );
+   void token::delete_by_hub_trx_id( name peerchain_name, const transaction_id_type& hub_trx_id ){
+      name scope = get_hub_trx_scope( hub_trx_id, true, peerchain_name );
+      if ( scope == name() ){
+         return;
+      }
+      auto _hubtrxs = hubtrxs_table( _self, scope.value );
       auto idx = _hubtrxs.get_index<"hubtrxid"_n>();
-      auto hub_trx_p = idx.find(fixed_bytes<32>(hub_trx_id.hash));
+      auto hub_trx_p = find_by_trx_id( idx, hub_trx_id, []( const auto& r ){ return r.hub_trx_id; } );
       if( hub_trx_p == idx.end()){
          return;
       }
 
-      /// transfer fee to receiver
-      const auto& acpt = get_currency_accept( hub_trx_p->from_quantity.symbol.code() );
-      auto fee = hub_trx_p->from_quantity - hub_trx_p->to_quantity;
+      /// accrue fee of the receiver, paid out by settlehub
       auto receiver = hub_trx_p->fee_receiver;
-
-      if ( receiver == name() || (! is_account(receiver))){
+      if ( receiver == name() ){
          receiver = _self;
       }
-
-      if ( fee.amount > 0 ){
-         if ( acpt.original_contract == _self ){
-            const auto& balance = get_balance( _self, _hubgs.hub_account, hub_trx_p->from_quantity.symbol.code() );
-            if ( balance >= fee ){
-               transfer_action_type action_data{ _hubgs.hub_account, receiver, fee, "hub trx fee"};
-               action( permission_level{ _self, "active"_n }, _self, "feetransfer"_n, action_data ).send();
-            }
-         } else {
-            if ( receiver != _self && receiver != _hubgs.hub_account ){
-               transfer_action_type action_data{ _self, receiver, fee, "hub trx fee"};
-               action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ).send();
-            }
-         }
-      }
+      accrue_hub_fee( receiver, hub_trx_p->from_quantity() - hub_trx_p->to_quantity() );
 
       /// delete
       _hubtrxs.erase( *hub_trx_p );
-      _hubgs.unfinished_trxs -= 1;
+
+      hubqueues_table _hubqueues( _self, _self.value );
+      const auto& queue = _hubqueues.get( scope.value, "hub queue not found" );
+      _hubqueues.modify( queue, same_payer, [&]( auto& r ) {
+         r.unfinished_trxs -= 1;
+      });
+   }
+
+   /**
+    * table hubtrxs is scoped by to_chain, a hub trx transferred back to its original chain is confirmed or rolled back
+    * by that chain, which is not its scope, so the other scopes are searched when it's not found in the scope of hint_chain.
+    * returns name() if not found.
+    */
+   name token::get_hub_trx_scope( const transaction_id_type& trx_id, bool by_hub_trx_id, name hint_chain ){
+      auto exists_in = [&]( name scope ){
+         auto _hubtrxs = hubtrxs_table( _self, scope.value );
+         if ( by_hub_trx_id ){
+            auto idx = _hubtrxs.get_index<"hubtrxid"_n>();
+            return find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.hub_trx_id; } ) != idx.end();
+         }
+         auto idx = _hubtrxs.get_index<"origtrxid"_n>();
+         return find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.orig_trx_id; } ) != idx.end();
+      };
+
+      hubqueues_table _hubqueues( _self, _self.value );
+      if ( hint_chain != name() && _hubqueues.find( hint_chain.value ) != _hubqueues.end() && exists_in( hint_chain ) ){
+         return hint_chain;
+      }
+      for ( const auto& queue : _hubqueues ){
+         if ( queue.to_chain != hint_chain && queue.unfinished_trxs != 0 && exists_in( queue.to_chain ) ){
+            return queue.to_chain;
+         }
+      }
+      return name();
    }
 
    void token::hubinit( name hub_account ){
@@ -1834,6 +2521,91 @@ namespace eosio {
       eosio::check( _hubgs.is_open == false, "already init");
       _hubgs.is_open = true;
       _hubgs.hub_account = hub_account;
+      _hubgs_changed = true;
+   }
+
+   void token::sethubqueue( name to_chain, uint64_t max_unfinished_trxs ){
+      check_admin_auth();
+      _peerchains.get( to_chain.value, "dest chain has not registered");
+
+      hubqueues_table _hubqueues( _self, _self.value );
+      auto queue = _hubqueues.find( to_chain.value );
+      if ( queue == _hubqueues.end() ){
+         _hubqueues.emplace( _self, [&]( auto& r ) {
+            r.to_chain              = to_chain;
+            r.max_unfinished_trxs   = max_unfinished_trxs;
+         });
+      } else {
+         _hubqueues.modify( queue, same_payer, [&]( auto& r ) {
+            r.max_unfinished_trxs = max_unfinished_trxs;
+         });
+      }
+   }
+
+   void token::evhubtrx( name to_chain, uint64_t id, const transaction_id_type& orig_trx_id, const checksum256& memo_hash, const string& memo ){
+      require_auth( _self );
+      if ( _events_st.log_account != name() ){ require_recipient( _events_st.log_account ); }
+   }
+
+   void token::accrue_hub_fee( name receiver, const asset& fee ){
+      if ( receiver == _hubgs.hub_account || fee.amount <= 0 ){
+         return;
+      }
+
+      hubfees_table _hubfees( _self, _self.value );
+      auto idx = _hubfees.get_index<"receiversym"_n>();
+      auto itr = idx.find( hub_fee_key( receiver, fee.symbol.code() ) );
+      if ( itr == idx.end() ){
+         _hubfees.emplace( _self, [&]( auto& r ){
+            r.id        = _hubfees.available_primary_key();
+            r.receiver  = receiver;
+            r.balance   = fee;
+         });
+      } else {
+         idx.modify( itr, same_payer, [&]( auto& r ){
+            r.balance += fee;
+         });
+      }
+   }
+
+   /**
+    * fees of tokens issued by this contract are kept in the balance of the hub account until settled,
+    * fees of other tokens are kept by this contract and transferred by their original contracts.
+    */
+   void token::settlehub( uint32_t max_rows ){
+      eosio::check( max_rows > 0, "max_rows must be greater than zero" );
+
+      hubfees_table _hubfees( _self, _self.value );
+      auto itr = _hubfees.begin();
+      for ( uint32_t count = 0; itr != _hubfees.end() && count < max_rows; ++count ){
+         auto receiver = itr->receiver;
+         if ( ! is_account(receiver) ){
+            receiver = _self;
+         }
+
+         const auto& fee = itr->balance;
+         const auto& acpt = get_currency_accept( fee.symbol.code() );
+         if ( acpt.original_contract == _self ){
+            // keep the row until the hub account can cover the fee, so the fee is not lost
+            accounts hub_acnts( _self, _hubgs.hub_account.value );
+            auto it_hub = hub_acnts.find( fee.symbol.code().raw() );
+            if ( it_hub == hub_acnts.end() || it_hub->balance < fee ){
+               IBC_LOG_DEBUG( "skip hub fee % to %, insufficient hub balance", fee, receiver );
+               ++itr;
+               continue;
+            }
+            transfer_action_type action_data{ _hubgs.hub_account, receiver, fee, "hub trx fee"};
+            send_inline( action( permission_level{ _self, "active"_n }, _self, "feetransfer"_n, action_data ) );
+         } else {
+            if ( receiver != _self && receiver != _hubgs.hub_account ){
+               transfer_action_type action_data{ _self, receiver, fee, "hub trx fee"};
+               send_inline( action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ) );
+            }
+         }
+
+         IBC_LOG_DEBUG( "settle hub fee % to %", fee, receiver );
+         itr = _hubfees.erase( itr );
+      }
    }
 
    void token::feetransfer( name from, name to, asset quantity, string memo ){
@@ -1920,12 +2692,12 @@ namespace eosio {
 
       auto _rmdunrbs2 = rmdunrbs_table2( _self, _self.value );
       auto idx = _rmdunrbs2.get_index<"trxid"_n>();
-      auto trx_p = idx.find(fixed_bytes<32>(trx_id));
+      auto trx_p = find_by_trx_id( idx, trx_id, []( const auto& r ){ return r.trx_id; } );
       eosio::check(trx_p!=idx.end(),"trx_id not exist in table rmdunrbs2");
 
       transfer_action_info action_info = trx_p->action;
       string memo = "rollback transaction: " + checksum256_to_string(trx_id);
-      print( memo.c_str() );
+      IBC_LOG_DEBUG( "%", memo );
 
       bool ibc_withdraw = false;
       auto sym_code_raw = action_info.quantity.symbol.code().raw();
@@ -1943,7 +2715,7 @@ namespace eosio {
          });
 
          transfer_action_type action_data{ _self, action_info.from, action_info.quantity, memo };
-         action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ).send();
+         send_inline( action( permission_level{ _self, "active"_n }, acpt.original_contract, "transfer"_n, action_data ) );
       } else { // rollback ibc withdraw
          const auto& st = get_currency_stats( action_info.quantity.symbol.code() );
          _stats.modify( st, same_payer, [&]( auto& r ) {
@@ -1951,12 +2723,11 @@ namespace eosio {
             r.max_supply += action_info.quantity;
             r.total_withdraw -= action_info.quantity;
             r.total_withdraw_times -= 1;
+            r.stats2_dirty.emplace( true );
          });
 
          transfer_action_type action_data{ _self, action_info.from, action_info.quantity, memo };
-         action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ).send();
-
-         update_stats2( st.supply.symbol.code() );
+         send_inline( action( permission_level{ _self, "active"_n }, _self, "transfer"_n, action_data ) );
       }
 
       _rmdunrbs2.erase( *trx_p );
@@ -1972,9 +2743,10 @@ extern "C" {
             (regpegtoken)(setpegasset)(setpegint)(setpegbool)(setpegtkfee)
             (transfer)(cash)(cashconfirm)(rollback)(rmunablerb)(fcrollback)(fcrmorigtrx)
             (lockall)(unlockall)(forceinit)(open)(close)(unregtoken)(setfreeacnt)(setadmin)(setprchproxy)
-            (setproxy)(mvunrtotbl2)(rbkunrbktrx)
+            (setproxy)(mvunrtotbl2)(rbkunrbktrx)(setlanes)(setsymlane)(delsymlane)(bundletransfer)(cashbundle)(mvcashtrxs)
+            (claimfees)(cashnotify)(syncstats)(setevents)(evorigtrx)(evcash)(evconfirm)(evrollback)
 #ifdef HUB
-            (hubinit)(feetransfer)(regpegtoken2)(rbkdiehubtrx)
+            (hubinit)(feetransfer)(regpegtoken2)(rbkdiehubtrx)(sethubqueue)(cashfwd)(settlehub)(evhubtrx)
 #endif
             )
          }
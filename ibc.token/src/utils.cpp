@@ -3,15 +3,18 @@
  *  @copyright defined in eos/LICENSE.txt
  */
 
-#include <ctype.h>
+#include <array>
+#include <cstring>
+#include <string_view>
 
 namespace eosio{
 
-   void trim(string &s) {
-      if( !s.empty() ) {
-         s.erase(0,s.find_first_not_of(" "));
-         s.erase(s.find_last_not_of(" ") + 1);
-      }
+   std::string_view trim( std::string_view s ) {
+      auto pos = s.find_first_not_of(' ');
+      if ( pos == std::string_view::npos ){ return std::string_view(); }
+      s.remove_prefix( pos );
+      s.remove_suffix( s.size() - s.find_last_not_of(' ') - 1 );
+      return s;
    }
 
    checksum256 get_trx_id( bool assert_only_one_action = true ) {
@@ -20,7 +23,7 @@ namespace eosio{
       size_t trx_size = transaction_size();
       trx_bytes.resize(trx_size);
       read_transaction(trx_bytes.data(), trx_size);
-      assert_sha256( trx_bytes.data(), trx_size, trx_id );
+      ibc_assert_sha256( trx_bytes.data(), trx_size, trx_id );
       
       if ( assert_only_one_action ) {
          auto trx = unpack<transaction>(trx_bytes.data(), trx_size);
@@ -42,19 +45,38 @@ namespace eosio{
       return r;
    }
 
+   /// hex digit value of every char, -1 for non-hex chars
+   constexpr std::array<int8_t,256> make_hex_table(){
+      std::array<int8_t,256> t{};
+      for ( int i = 0; i < 256; ++i ){ t[i] = -1; }
+      for ( int i = 0; i < 10; ++i ){ t['0' + i] = i; }
+      for ( int i = 0; i < 6; ++i ){ t['a' + i] = 10 + i; t['A' + i] = 10 + i; }
+      return t;
+   }
+   constexpr auto hex_table = make_hex_table();
+
+   /// 5 bits value of every char allowed in an eosio name, -1 for others
+   constexpr std::array<int8_t,256> make_name_table(){
+      std::array<int8_t,256> t{};
+      for ( int i = 0; i < 256; ++i ){ t[i] = -1; }
+      t['.'] = 0;
+      for ( int i = 0; i < 5; ++i ){ t['1' + i] = 1 + i; }
+      for ( int i = 0; i < 26; ++i ){ t['a' + i] = 6 + i; }
+      return t;
+   }
+   constexpr auto name_table = make_name_table();
+
    uint8_t hex_char_to_uint8( char c ){
-      char lower_c = tolower(c);
-      const string hex_code = "0123456789abcdef";
-      auto pos = hex_code.find(lower_c);
-      eosio::check(pos != std::string::npos, "it's not a hex char");
-      return pos;
+      auto v = hex_table[ uint8_t(c) ];
+      eosio::check( v >= 0, "it's not a hex char");
+      return v;
    }
 
    string checksum256_to_string( checksum256 value ){
       return to_hex( (uint8_t*)value.data(), 32 );
    }
 
-   checksum256 string_to_checksum256( const string& str ){
+   checksum256 string_to_checksum256( std::string_view str ){
       eosio::check( str.size() == 64, "checksum256 string size must be 64");
       checksum256 ret;
       for (int i = 0; i < 32; ++i ){
@@ -63,7 +85,26 @@ namespace eosio{
       return ret;
    }
 
-
+   /// same encoding and checks as eosio::name( std::string_view ), but table driven
+   name string_to_name( std::string_view str ){
+      eosio::check( str.size() <= 13, "string is too long to be a valid name" );
+      if ( str.empty() ){ return name(); }
+      uint64_t value = 0;
+      auto n = std::min( str.size(), size_t(12) );
+      for ( size_t i = 0; i < n; ++i ){
+         auto v = name_table[ uint8_t(str[i]) ];
+         eosio::check( v >= 0, "character is not in allowed character set for names" );
+         value = ( value << 5 ) | uint64_t(v);
+      }
+      value <<= ( 4 + 5 * ( 12 - n ) );
+      if ( str.size() == 13 ){
+         auto v = name_table[ uint8_t(str[12]) ];
+         eosio::check( v >= 0, "character is not in allowed character set for names" );
+         eosio::check( v <= 0x0F, "thirteenth character in name cannot be a letter that comes after j" );
+         value |= uint64_t(v);
+      }
+      return name( value );
+   }
 
    /**
     * ---- 'ibc transfer action's memo string format' ----
@@ -72,68 +113,161 @@ namespace eosio{
     * examples:
     * 'bosaccount31@bos happy new year 2019'
     * 'bosaccount32@bos'
+    *
+    * the user-defined string may carry space separated 'key=value' pairs, which are added by ibc.proxy
+    * (orig_trxid, orig_from) or by the hub relay (orig_trx_id, worker), the first occurrence of a key wins.
+    *
+    * ---- binary memo format (v2) ----
+    * optional compact format for machine-generated memos, recognized by the first byte being memo_v2_prefix,
+    * names are uint64 little endian (same as packed), fields are present only when their flag is set:
+    *
+    *    offset  size  field
+    *    0       1     memo_v2_prefix
+    *    1       1     flags, see memo_v2_flag_*
+    *    2       8     receiver
+    *    10      8     chain
+    *            32    orig trx id, fills both orig_trxid and orig_trx_id
+    *            8     orig_from
+    *            8     worker
+    *            rest  notes, not trimmed and not scanned for key=value pairs
     */
+   constexpr char    memo_v2_prefix                = 0x02;
+   constexpr uint8_t memo_v2_flag_orig_trx_id      = 0x01;
+   constexpr uint8_t memo_v2_flag_orig_from        = 0x02;
+   constexpr uint8_t memo_v2_flag_worker           = 0x04;
+   constexpr size_t  memo_v2_header_size           = 18;
+
+   bool is_memo_v2( std::string_view memo ){
+      return !memo.empty() && memo[0] == memo_v2_prefix;
+   }
+
+   name read_memo_v2_name( std::string_view field ){
+      uint64_t value;
+      std::memcpy( &value, field.data(), sizeof(value) );
+      return name( value );
+   }
+
+   void decode_memo_v2( std::string_view memo, memo_info_type& info ){
+      eosio::check( memo.size() >= memo_v2_header_size, "binary memo too short" );
+      uint8_t flags = memo[1];
+      eosio::check( ( flags & ~( memo_v2_flag_orig_trx_id | memo_v2_flag_orig_from | memo_v2_flag_worker ) ) == 0, "unknown binary memo flags" );
+
+      info.binary    = true;
+      info.receiver  = read_memo_v2_name( memo.substr( 2, 8 ) );
+      info.peerchain = read_memo_v2_name( memo.substr( 10, 8 ) );
+      memo.remove_prefix( memo_v2_header_size );
+
+      auto take = [&]( uint8_t flag, size_t size, std::string_view& field ){
+         if ( ( flags & flag ) == 0 ){ return; }
+         eosio::check( memo.size() >= size, "binary memo too short" );
+         field = memo.substr( 0, size );
+         memo.remove_prefix( size );
+      };
+      take( memo_v2_flag_orig_trx_id, 32, info.orig_trxid );
+      info.orig_trx_id = info.orig_trxid;
+      take( memo_v2_flag_orig_from, 8, info.orig_from );
+      take( memo_v2_flag_worker, 8, info.worker );
+      info.notes = memo;
+   }
+
+   string encode_memo_v2( name receiver, name peerchain, std::string_view notes,
+                          const checksum256* orig_trx_id = nullptr, name orig_from = name(), name worker = name() ){
+      uint8_t flags = ( orig_trx_id != nullptr ? memo_v2_flag_orig_trx_id : 0 ) |
+                      ( orig_from != name() ? memo_v2_flag_orig_from : 0 ) |
+                      ( worker != name() ? memo_v2_flag_worker : 0 );
+      string memo;
+      memo.reserve( memo_v2_header_size + 48 + notes.size() );
+      memo += memo_v2_prefix;
+      memo += char(flags);
+      auto append_name = [&]( name n ){ memo.append( (const char*)&n.value, sizeof(n.value) ); };
+      append_name( receiver );
+      append_name( peerchain );
+      if ( orig_trx_id != nullptr ){ memo.append( (const char*)orig_trx_id->data(), 32 ); }
+      if ( orig_from != name() ){ append_name( orig_from ); }
+      if ( worker != name() ){ append_name( worker ); }
+      memo.append( notes.data(), notes.size() );
+      return memo;
+   }
+
+   /// fills the key=value members of info from the space separated tokens of src, without copying,
+   /// src is scanned as text even if it starts with memo_v2_prefix, binary memos are recognized only at the start of a full memo
+   void get_memo_key_values( std::string_view src, memo_info_type& info ){
+      while ( !src.empty() ){
+         auto pos = src.find(' ');
+         auto token = src.substr( 0, pos );
+         src = pos == std::string_view::npos ? std::string_view() : src.substr( pos + 1 );
+
+         auto eq = token.find('=');
+         if ( eq == std::string_view::npos ){ continue; }
+         auto key = token.substr( 0, eq );
+         auto value = token.substr( eq + 1 );
 
-   struct memo_info_type {
-      name     receiver;
-      name     peerchain;
-      string   notes;
-   };
+         std::string_view* field = nullptr;
+         if ( key == "orig_trxid" ){ field = &info.orig_trxid; }
+         else if ( key == "orig_from" ){ field = &info.orig_from; }
+         else if ( key == "orig_trx_id" ){ field = &info.orig_trx_id; }
+         else if ( key == "worker" ){ field = &info.worker; }
 
-   memo_info_type get_memo_info( const string& memo_str ){
+         if ( field != nullptr && field->empty() ){ *field = value; }
+      }
+   }
+
+   /// fills the key=value members of info from a full memo, a binary memo is decoded as a whole
+   void get_memo_values( std::string_view memo, memo_info_type& info ){
+      if ( is_memo_v2( memo ) ){
+         decode_memo_v2( memo, info );
+         return;
+      }
+      get_memo_key_values( memo, info );
+   }
+
+   memo_info_type get_memo_info( std::string_view memo_str ){
       static const string format = "{receiver}@{chain} {user-defined string}";
       memo_info_type info;
 
-      string memo = memo_str;
-      trim( memo );
+      // binary fields may contain space bytes, so a binary memo is never trimmed
+      if ( is_memo_v2( memo_str ) ){
+         decode_memo_v2( memo_str, info );
+         eosio::check( info.receiver != name(), ( string("memo format error, receiver not provided, correct format: ") + format ).c_str() );
+         eosio::check( info.peerchain != name(), ( string("memo format error, chain not provided, correct format: ") + format ).c_str() );
+         return info;
+      }
 
-      // --- get receiver ---
-      auto pos = memo.find("@");
-      eosio::check( pos != std::string::npos, ( string("memo format error, didn't find charactor \'@\' in memo, correct format: ") + format ).c_str() );
-      string receiver_str = memo.substr( 0, pos );
-      trim( receiver_str );
-      info.receiver = name( receiver_str );
+      auto memo = trim( memo_str );
 
-      // --- trim ---
-      memo = memo.substr( pos + 1 );
-      trim( memo );
+      // --- get receiver ---
+      auto pos = memo.find('@');
+      eosio::check( pos != std::string_view::npos, ( string("memo format error, didn't find charactor \'@\' in memo, correct format: ") + format ).c_str() );
+      info.receiver = string_to_name( trim( memo.substr( 0, pos ) ) );
+      memo = trim( memo.substr( pos + 1 ) );
 
       // --- get chain name and notes ---
-      pos = memo.find_first_not_of("abcdefghijklmnopqrstuvwxyz012345");
-      if ( pos == std::string::npos ){
-         info.peerchain = name( memo );
-         info.notes = "";
-      } else {
-         info.peerchain = name( memo.substr(0,pos) );
-         info.notes = memo.substr( pos ); // important: not + 1
-         trim( info.notes );
-      }
+      size_t i = 0;
+      while ( i < memo.size() && ( ( memo[i] >= 'a' && memo[i] <= 'z' ) || ( memo[i] >= '0' && memo[i] <= '5' ) ) ){ ++i; }
+      info.peerchain = string_to_name( memo.substr( 0, i ) );
+      info.notes = trim( memo.substr( i ) ); // important: not + 1
 
       eosio::check( info.receiver != name(), ( string("memo format error, receiver not provided, correct format: ") + format ).c_str() );
       eosio::check( info.peerchain != name(), ( string("memo format error, chain not provided, correct format: ") + format ).c_str() );
+
+      get_memo_key_values( info.notes, info );
       return info;
    }
 
-   string get_value_str_by_key_str(const string& src, const string& key_str ){
-      string src_str = src;
-      string value_str;
-      auto pos = src_str.find( key_str );
-      if ( pos == std::string::npos ){ return string(); }
-
-      src_str = src_str.substr(pos + key_str.length());
-      trim( src_str );
-      pos = src_str.find("=");
-      if ( pos == std::string::npos ){ return string(); }
-
-      src_str = src_str.substr(1);
-      trim( src_str );
-      pos = src_str.find(' ');
-      if ( pos == std::string::npos ){
-         value_str = src_str;
-      } else {
-         value_str = src_str.substr(0,pos);
-      }
+   /// name value of a key=value member of memo_info_type, name() if the key is not present
+   name memo_value_to_name( const memo_info_type& info, std::string_view value ){
+      if ( value.empty() ){ return name(); }
+      return info.binary ? read_memo_v2_name( value ) : string_to_name( value );
+   }
 
-      return value_str;
+   /// checksum256 value of a key=value member of memo_info_type, the key must be present
+   checksum256 memo_value_to_checksum256( const memo_info_type& info, std::string_view value ){
+      if ( info.binary ){
+         eosio::check( value.size() == 32, "orig trx id not exist in binary memo" );
+         checksum256 ret;
+         std::memcpy( ret.data(), value.data(), 32 );
+         return ret;
+      }
+      return string_to_checksum256( value );
    }
 }